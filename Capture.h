@@ -0,0 +1,178 @@
+#pragma once
+#include "Logger.h"
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// TrafficCapture 把抽样的原始 HTTP/1.x 请求连同到达时间追加写入二进制文件，供 replay 工具回放。
+// 文件格式（主机字节序）：
+//     文件头  8 字节魔数 "HSCAPT01"
+//     记录    uint64 到达时间（Unix 微秒） + uint32 长度 + 请求原始字节
+// 文件只追加不修改，多次运行可以写入同一个文件；进程异常退出时末尾可能留下不完整的记录，读取时忽略。
+// 记录中包含 Cookie、登录表单等敏感数据，文件以 0600 权限创建。
+// I/O 线程只把记录复制进有界队列，由后台线程写文件：页缓存写入在脏页回写限流时会阻塞，
+// 不能让它拖住所有连接、扭曲要测量的延迟。队列满时丢弃记录并计数。
+// HTTP/2 请求在协议层被拆成帧，没有可以直接回放的原始报文，不记录。
+class TrafficCapture {
+public:
+    struct Record {
+        uint64_t timestampUs;
+        std::string data;
+    };
+
+    TrafficCapture() = default;
+    TrafficCapture(const TrafficCapture&) = delete;
+    TrafficCapture& operator=(const TrafficCapture&) = delete;
+
+    ~TrafficCapture() {
+        if (writer.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            wakeup.notify_one();
+            writer.join(); // 写完队列中剩余的记录
+        }
+        if (dropped > 0) {
+            LOG_WARNING("Capture dropped %zu records because the write queue was full", dropped);
+        }
+        if (fd >= 0) close(fd);
+    }
+
+    // 每 sampleEvery 个请求记录一个（按顺序抽样，同样的流量得到同样的抽样结果），写满 maxBytes 后停止
+    bool open(const std::string& path, size_t sampleEvery, size_t maxBytes) {
+        fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+        if (fd < 0) {
+            LOG_ERROR("Failed to open capture file %s: %s", path.c_str(), strerror(errno));
+            return false;
+        }
+        every = sampleEvery > 0 ? sampleEvery : 1;
+        limit = maxBytes;
+        off_t size = lseek(fd, 0, SEEK_END);
+        if (size == 0 && write(fd, MAGIC, MAGIC_SIZE) != static_cast<ssize_t>(MAGIC_SIZE)) {
+            LOG_ERROR("Failed to write capture file header: %s", strerror(errno));
+            close(fd);
+            fd = -1;
+            return false;
+        }
+        written = size > 0 ? size : MAGIC_SIZE;
+        writer = std::thread([this]() { writeLoop(); });
+        return true;
+    }
+
+    // 请求完整到达时在 I/O 线程上调用，只复制记录并唤醒写线程，不做文件 I/O
+    void record(const char* data, size_t len) {
+        if (fd < 0 || seen++ % every != 0) {
+            return;
+        }
+        if (limit > 0 && written + HEADER_SIZE + len > limit) {
+            if (!full) {
+                LOG_WARNING("Capture file reached %zu bytes, capture stopped", limit);
+                full = true;
+            }
+            return;
+        }
+        uint64_t timestamp = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        uint32_t length = static_cast<uint32_t>(len);
+        std::string entry(HEADER_SIZE + len, '\0');
+        memcpy(&entry[0], &timestamp, sizeof(timestamp));
+        memcpy(&entry[sizeof(timestamp)], &length, sizeof(length));
+        memcpy(&entry[HEADER_SIZE], data, len);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (queuedBytes + entry.size() > MAX_QUEUED_BYTES) {
+                if (dropped++ == 0) {
+                    LOG_WARNING("Capture write queue is full, dropping records");
+                }
+                return;
+            }
+            queuedBytes += entry.size();
+            queue.push_back(std::move(entry));
+        }
+        written += HEADER_SIZE + len; // 按入队计算，文件大小上限与写线程的进度无关
+        wakeup.notify_one();
+    }
+
+    // 读取整个抓包文件，末尾不完整的记录被丢弃
+    static bool load(const std::string& path, std::vector<Record>& records) {
+        std::ifstream file(path, std::ios::binary);
+        char magic[MAGIC_SIZE];
+        if (!file.read(magic, MAGIC_SIZE) || memcmp(magic, MAGIC, MAGIC_SIZE) != 0) {
+            return false;
+        }
+        Record record;
+        uint32_t length;
+        while (file.read(reinterpret_cast<char*>(&record.timestampUs), sizeof(record.timestampUs)) &&
+               file.read(reinterpret_cast<char*>(&length), sizeof(length))) {
+            record.data.resize(length);
+            if (!file.read(&record.data[0], length)) {
+                break;
+            }
+            records.push_back(record);
+        }
+        return true;
+    }
+
+private:
+    // 写线程：每次取走队列中的全部记录，用一次 writev 追加（O_APPEND 保证记录不会交错），只进页缓存，不等落盘
+    void writeLoop() {
+        std::deque<std::string> batch;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wakeup.wait(lock, [this]() { return stopping || !queue.empty(); });
+                if (queue.empty()) {
+                    return; // stopping 且已写完
+                }
+                batch.swap(queue);
+                queuedBytes = 0;
+            }
+            while (!batch.empty()) {
+                struct iovec iov[IOV_BATCH];
+                size_t count = std::min(batch.size(), IOV_BATCH);
+                for (size_t i = 0; i < count; ++i) {
+                    iov[i] = {&batch[i][0], batch[i].size()};
+                }
+                if (writev(fd, iov, static_cast<int>(count)) < 0) {
+                    LOG_ERROR("Failed to write capture file: %s", strerror(errno));
+                }
+                batch.erase(batch.begin(), batch.begin() + count);
+            }
+        }
+    }
+
+    static constexpr const char* MAGIC = "HSCAPT01";
+    static constexpr size_t MAGIC_SIZE = 8;
+    static constexpr size_t HEADER_SIZE = sizeof(uint64_t) + sizeof(uint32_t);
+    static constexpr size_t MAX_QUEUED_BYTES = 64 * 1024 * 1024; // 等待写入的记录总量上限
+    static constexpr size_t IOV_BATCH = 64;
+
+    int fd = -1;
+    size_t every = 1;
+    uint64_t seen = 0;
+    size_t limit = 0;
+    size_t written = 0;
+    bool full = false;
+    size_t dropped = 0;
+
+    // 以上字段只在 I/O 线程上访问；以下队列由 mutex 保护，与写线程共享
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    std::deque<std::string> queue;
+    size_t queuedBytes = 0;
+    bool stopping = false;
+    std::thread writer;
+};
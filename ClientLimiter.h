@@ -0,0 +1,228 @@
+#pragma once
+#include "Hash.h"
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// ClientLimiter 按客户端限制请求速率和并发连接数，防止单个客户端占满线程池和数据库。
+// 请求速率用令牌桶：每秒补充 requestsPerSecond 个令牌，最多积攒 burst 个，每个请求消耗一个。
+// 客户端表按键分片，每个分片一把锁；长时间没有活动且没有连接的条目在访问分片时顺带清理，
+// 此时令牌桶早已补满，删除它和保留它的效果相同。
+class ClientLimiter {
+public:
+    struct Limits {
+        double requestsPerSecond = 0; // 0 表示不限制请求速率
+        double burst = 0;             // 令牌桶容量，0 时取 requestsPerSecond
+        size_t maxConnections = 0;    // 单个客户端的并发连接上限，0 表示不限制
+        std::chrono::seconds idleTimeout{60};
+    };
+
+    explicit ClientLimiter(size_t shardCount = 16) : shards(shardCount) {}
+
+    void configure(const Limits& value) {
+        limits = value;
+        if (limits.burst <= 0) {
+            limits.burst = limits.requestsPerSecond;
+        }
+        // 空闲时间至少要够令牌桶补满，否则清理条目会让客户端平白多得令牌
+        if (limits.requestsPerSecond > 0) {
+            auto refill = std::chrono::seconds(static_cast<long>(limits.burst / limits.requestsPerSecond) + 1);
+            limits.idleTimeout = std::max(limits.idleTimeout, refill);
+        }
+    }
+
+    bool enabled() const {
+        return limits.requestsPerSecond > 0 || limits.maxConnections > 0;
+    }
+
+    // 消耗一个令牌，令牌不足时返回 false
+    bool allowRequest(const std::string& client) {
+        if (limits.requestsPerSecond <= 0) {
+            return true;
+        }
+        auto now = std::chrono::steady_clock::now();
+        Shard& shard = shardFor(client);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        Entry& entry = shard.touch(client, now, limits);
+        double elapsed = std::chrono::duration<double>(now - entry.refilled).count();
+        entry.tokens = std::min(limits.burst, entry.tokens + elapsed * limits.requestsPerSecond);
+        entry.refilled = now;
+        if (entry.tokens < 1) {
+            rejectedRequests.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        entry.tokens -= 1;
+        return true;
+    }
+
+    // 登记一个新连接，超过并发上限时返回 false（不登记）；成功时必须配对调用 releaseConnection
+    bool acquireConnection(const std::string& client) {
+        if (limits.maxConnections == 0) {
+            return true;
+        }
+        auto now = std::chrono::steady_clock::now();
+        Shard& shard = shardFor(client);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        Entry& entry = shard.touch(client, now, limits);
+        if (entry.connections >= limits.maxConnections) {
+            rejectedConnections.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        ++entry.connections;
+        return true;
+    }
+
+    void releaseConnection(const std::string& client) {
+        Shard& shard = shardFor(client);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.entries.find(client);
+        if (it != shard.entries.end() && it->second.connections > 0) {
+            --it->second.connections;
+            it->second.lastSeen = std::chrono::steady_clock::now();
+        }
+    }
+
+    std::string statsString() {
+        size_t clients = 0;
+        for (auto& shard : shards) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            clients += shard.entries.size();
+        }
+        std::ostringstream oss;
+        oss << "limiter_clients " << clients << "\n"
+            << "limiter_rejected_requests " << rejectedRequests.load() << "\n"
+            << "limiter_rejected_connections " << rejectedConnections.load() << "\n";
+        return oss.str();
+    }
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    struct Entry {
+        double tokens = 0;
+        Clock::time_point refilled;
+        Clock::time_point lastSeen;
+        size_t connections = 0;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<std::string, Entry> entries;
+        Clock::time_point nextSweep;
+
+        // 查找或创建条目；顺带按间隔清理空闲条目，代价分摊到各次访问上
+        Entry& touch(const std::string& client, Clock::time_point now, const Limits& limits) {
+            if (now >= nextSweep) {
+                for (auto it = entries.begin(); it != entries.end();) {
+                    if (it->second.connections == 0 && now - it->second.lastSeen > limits.idleTimeout) {
+                        it = entries.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+                nextSweep = now + limits.idleTimeout / 4;
+            }
+            auto result = entries.try_emplace(client);
+            Entry& entry = result.first->second;
+            if (result.second) {
+                entry.tokens = limits.burst; // 新客户端从满桶开始
+                entry.refilled = now;
+            }
+            entry.lastSeen = now;
+            return entry;
+        }
+    };
+
+    Shard& shardFor(const std::string& client) {
+        return shards[XXHash64::hash(client.data(), client.size()) % shards.size()];
+    }
+
+    Limits limits;
+    std::vector<Shard> shards;
+    std::atomic<uint64_t> rejectedRequests{0};
+    std::atomic<uint64_t> rejectedConnections{0};
+};
+
+// 可信反向代理的地址段（CIDR）。来自这些地址的连接代表许多客户端，
+// 限流时改用它转发的 X-Real-IP / X-Forwarded-For 区分客户端；其他对端可以随意伪造这些请求头。
+// IPv4 映射的 IPv6 地址（::ffff:a.b.c.d）按 IPv4 地址匹配。
+class TrustedProxies {
+public:
+    // 添加一个地址段，如 "172.20.0.0/16"、"::1/128"；不带前缀长度时表示单个地址
+    bool add(const std::string& cidr) {
+        Range range;
+        size_t slash = cidr.find('/');
+        std::string address = cidr.substr(0, slash);
+        if (inet_pton(AF_INET, address.c_str(), range.bytes) == 1) {
+            range.family = AF_INET;
+            range.prefix = 32;
+        } else if (inet_pton(AF_INET6, address.c_str(), range.bytes) == 1) {
+            range.family = AF_INET6;
+            range.prefix = 128;
+        } else {
+            return false;
+        }
+        if (slash != std::string::npos) {
+            char* end = nullptr;
+            long prefix = std::strtol(cidr.c_str() + slash + 1, &end, 10);
+            if (end == cidr.c_str() + slash + 1 || *end != '\0' || prefix < 0 || prefix > range.prefix) {
+                return false;
+            }
+            range.prefix = static_cast<int>(prefix);
+        }
+        ranges.push_back(range);
+        return true;
+    }
+
+    bool contains(const struct sockaddr_storage& addr) const {
+        int family = addr.ss_family;
+        const uint8_t* bytes;
+        if (family == AF_INET) {
+            bytes = reinterpret_cast<const uint8_t*>(&reinterpret_cast<const sockaddr_in&>(addr).sin_addr);
+        } else if (family == AF_INET6) {
+            const in6_addr& v6 = reinterpret_cast<const sockaddr_in6&>(addr).sin6_addr;
+            bytes = v6.s6_addr;
+            if (IN6_IS_ADDR_V4MAPPED(&v6)) {
+                family = AF_INET;
+                bytes += 12;
+            }
+        } else {
+            return false;
+        }
+        for (const auto& range : ranges) {
+            if (range.family == family && matches(range, bytes)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    struct Range {
+        int family = AF_INET;
+        uint8_t bytes[16] = {};
+        int prefix = 0;
+    };
+
+    static bool matches(const Range& range, const uint8_t* bytes) {
+        int full = range.prefix / 8;
+        if (memcmp(range.bytes, bytes, full) != 0) {
+            return false;
+        }
+        int bits = range.prefix % 8;
+        uint8_t mask = static_cast<uint8_t>(0xFF << (8 - bits));
+        return bits == 0 || (range.bytes[full] & mask) == (bytes[full] & mask);
+    }
+
+    std::vector<Range> ranges;
+};
@@ -0,0 +1,188 @@
+#pragma once
+#include "HttpResponse.h"
+#include <zlib.h>
+#include <cctype>
+#include <cstdlib>
+#include <memory>
+#include <string>
+
+// Compression 负责响应体的 gzip 压缩：按 Accept-Encoding 协商、按内容类型和大小决定是否压缩。
+// 整块响应体用每个线程一个、反复 deflateReset 的压缩上下文，避免每次分配 zlib 的内部状态（约 256KB）；
+// 流式响应体的压缩状态跨越多个块，各块可能在不同线程上生产，所以每个响应单独持有一个。
+class Compression {
+public:
+    struct Policy {
+        bool enabled = true;
+        size_t minSize = 1024; // 更小的响应体压缩后省不了几个字节，不值得花 CPU
+        int level = 5;         // 动态响应的压缩级别；写入缓存的响应只压缩一次，使用最高级别
+    };
+
+    // 客户端是否接受 gzip："gzip" 或 "*" 的 q 值大于 0；显式列出的 gzip 优先于 "*"
+    static bool acceptsGzip(const std::string& acceptEncoding) {
+        int gzip = -1, any = -1;
+        size_t pos = 0;
+        while (pos < acceptEncoding.size()) {
+            size_t end = acceptEncoding.find(',', pos);
+            if (end == std::string::npos) end = acceptEncoding.size();
+            std::string item = acceptEncoding.substr(pos, end - pos);
+            pos = end + 1;
+
+            size_t semicolon = item.find(';');
+            std::string coding = lower(trim(item.substr(0, semicolon)));
+            bool accepted = true;
+            if (semicolon != std::string::npos) {
+                std::string param = trim(item.substr(semicolon + 1));
+                if (param.size() > 2 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=') {
+                    accepted = std::strtod(param.c_str() + 2, nullptr) > 0;
+                }
+            }
+            if (coding == "gzip" || coding == "x-gzip") gzip = accepted;
+            else if (coding == "*") any = accepted;
+        }
+        return gzip >= 0 ? gzip == 1 : any == 1;
+    }
+
+    // 文本类内容才压缩；图片、压缩包等本身已经压缩过
+    static bool isCompressibleType(const std::string& contentType) {
+        std::string type = lower(trim(contentType.substr(0, contentType.find(';'))));
+        if (type.compare(0, 5, "text/") == 0) return true;
+        if (type == "application/json" || type == "application/javascript" || type == "application/xml" ||
+            type == "image/svg+xml") {
+            return true;
+        }
+        return endsWith(type, "+json") || endsWith(type, "+xml");
+    }
+
+    // 响应是否可以压缩（不考虑客户端）。文件响应走 sendfile 零拷贝并支持 Range，保持原样
+    static bool isCompressible(const HttpResponse& response) {
+        if (response.getStatusCode() != 200 || response.getFileBody()) {
+            return false;
+        }
+        const auto& headers = response.getHeaders();
+        if (headers.count("Content-Encoding") || headers.count("Content-Length")) {
+            return false;
+        }
+        auto type = headers.find("Content-Type");
+        return type != headers.end() && isCompressibleType(type->second);
+    }
+
+    // 整块压缩响应体，在调用线程上完成
+    static void compressBody(HttpResponse& response, int level) {
+        std::string compressed;
+        if (gzip(response.getBody(), compressed, level) && compressed.size() < response.getBody().size()) {
+            response.setBody(compressed);
+            response.setHeader("Content-Encoding", "gzip");
+        }
+    }
+
+    // 流式响应只包装生产者，每块在生产者的执行器上压缩后立即刷出（Z_SYNC_FLUSH），不会攒着不发。
+    // zlib 初始化失败时保持原样，不设置 Content-Encoding
+    static void compressStream(HttpResponse& response, int level) {
+        auto stream = std::make_shared<GzipStream>(level);
+        if (!stream->isReady()) {
+            return;
+        }
+        auto producer = response.getBodyProducer();
+        response.setStreamingBody([producer, stream](std::string& chunk) {
+            std::string plain;
+            bool more = (*producer)(plain);
+            stream->write(plain, chunk, !more);
+            return more;
+        }, response.getProducerExec());
+        response.setHeader("Content-Encoding", "gzip");
+    }
+
+    static bool gzip(const std::string& input, std::string& output, int level) {
+        thread_local Deflater deflater;
+        z_stream* zs = deflater.get(level);
+        if (!zs) {
+            return false;
+        }
+        output.resize(deflateBound(zs, input.size()));
+        zs->next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+        zs->avail_in = static_cast<uInt>(input.size());
+        zs->next_out = reinterpret_cast<Bytef*>(&output[0]);
+        zs->avail_out = static_cast<uInt>(output.size());
+        int ret = deflate(zs, Z_FINISH);
+        output.resize(zs->total_out);
+        deflateReset(zs);
+        return ret == Z_STREAM_END;
+    }
+
+private:
+    // 线程私有的 gzip 压缩上下文，级别变化时用 deflateParams 调整而不是重建
+    struct Deflater {
+        z_stream zs = {};
+        bool ready = false;
+        int level = 0;
+
+        z_stream* get(int wanted) {
+            if (!ready) {
+                if (deflateInit2(&zs, wanted, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+                    return nullptr;
+                }
+                ready = true;
+                level = wanted;
+            } else if (level != wanted) {
+                deflateParams(&zs, wanted, Z_DEFAULT_STRATEGY);
+                level = wanted;
+            }
+            return &zs;
+        }
+
+        ~Deflater() {
+            if (ready) deflateEnd(&zs);
+        }
+    };
+
+    class GzipStream {
+    public:
+        explicit GzipStream(int level) {
+            ready = deflateInit2(&zs, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+        }
+        GzipStream(const GzipStream&) = delete;
+        GzipStream& operator=(const GzipStream&) = delete;
+
+        ~GzipStream() {
+            if (ready) deflateEnd(&zs);
+        }
+
+        bool isReady() const {
+            return ready;
+        }
+
+        void write(const std::string& input, std::string& output, bool finish) {
+            zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(input.data()));
+            zs.avail_in = static_cast<uInt>(input.size());
+            int flush = finish ? Z_FINISH : Z_SYNC_FLUSH;
+            int ret;
+            do {
+                size_t used = output.size();
+                output.resize(used + input.size() / 2 + 64);
+                zs.next_out = reinterpret_cast<Bytef*>(&output[used]);
+                zs.avail_out = static_cast<uInt>(output.size() - used);
+                ret = deflate(&zs, flush);
+                output.resize(output.size() - zs.avail_out);
+            } while (ret == Z_OK && (zs.avail_in > 0 || zs.avail_out == 0 || finish));
+        }
+
+    private:
+        z_stream zs = {};
+        bool ready = false;
+    };
+
+    static std::string trim(const std::string& s) {
+        size_t start = s.find_first_not_of(" \t");
+        if (start == std::string::npos) return "";
+        return s.substr(start, s.find_last_not_of(" \t") + 1 - start);
+    }
+
+    static std::string lower(std::string s) {
+        for (auto& c : s) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+        return s;
+    }
+
+    static bool endsWith(const std::string& s, const std::string& suffix) {
+        return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+    }
+};
@@ -0,0 +1,358 @@
+#pragma once
+#include "Executor.h"
+#include "Logger.h"
+#include <sched.h>
+#include <sys/socket.h>
+#include <dirent.h>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// CpuTopology 描述本进程可以使用的 CPU（受亲和性掩码限制）以及它们所属的 NUMA 节点，
+// 用于自动确定线程数和绑核方案。读取不到 /sys 信息时视为单节点。
+struct CpuTopology {
+    std::vector<std::vector<int>> nodes; // 每个 NUMA 节点上可用的 CPU 编号
+
+    size_t cpuCount() const {
+        size_t n = 0;
+        for (const auto& node : nodes) n += node.size();
+        return n;
+    }
+
+    static CpuTopology detect() {
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        bool haveMask = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+        auto usable = [&](int cpu) { return !haveMask || CPU_ISSET(cpu, &allowed); };
+
+        CpuTopology topology;
+        if (DIR* dir = opendir("/sys/devices/system/node")) {
+            std::vector<int> nodeIds;
+            while (struct dirent* entry = readdir(dir)) {
+                if (strncmp(entry->d_name, "node", 4) == 0 && isdigit(static_cast<unsigned char>(entry->d_name[4]))) {
+                    nodeIds.push_back(std::atoi(entry->d_name + 4));
+                }
+            }
+            closedir(dir);
+            std::sort(nodeIds.begin(), nodeIds.end());
+            for (int id : nodeIds) {
+                std::ifstream file("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+                std::string list;
+                std::getline(file, list);
+                std::vector<int> cpus;
+                for (int cpu : parseCpuList(list)) {
+                    if (usable(cpu)) cpus.push_back(cpu);
+                }
+                if (!cpus.empty()) topology.nodes.push_back(std::move(cpus));
+            }
+        }
+        if (topology.nodes.empty()) {
+            std::vector<int> cpus;
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                if (haveMask ? CPU_ISSET(cpu, &allowed) : cpu < 1) cpus.push_back(cpu);
+            }
+            topology.nodes.push_back(std::move(cpus));
+        }
+        return topology;
+    }
+
+    // CPU 最多的节点，绑核时所有线程都放在这个节点上
+    const std::vector<int>& largestNode() const {
+        const std::vector<int>* node = &nodes.front();
+        for (const auto& candidate : nodes) {
+            if (candidate.size() > node->size()) node = &candidate;
+        }
+        return *node;
+    }
+
+    // 解析 "0-3,8-11" 形式的 CPU 列表
+    static std::vector<int> parseCpuList(const std::string& list) {
+        std::vector<int> cpus;
+        std::stringstream ss(list);
+        std::string range;
+        while (std::getline(ss, range, ',')) {
+            if (range.empty()) continue;
+            size_t dash = range.find('-');
+            int first = std::atoi(range.c_str());
+            int last = dash == std::string::npos ? first : std::atoi(range.c_str() + dash + 1);
+            for (int cpu = first; cpu <= last; ++cpu) cpus.push_back(cpu);
+        }
+        return cpus;
+    }
+};
+
+// 线程绑核方案：I/O 线程和 WORKER 线程都放在同一个 NUMA 节点上，
+// 连接缓冲区和请求对象在两者之间传递时不跨节点访问内存。
+struct ThreadPlacement {
+    int reactorCpu = -1;            // I/O 线程独占的核
+    std::vector<int> workerCpus;    // WORKER 线程逐个绑定
+    std::vector<int> blockingCpus;  // BLOCKING 线程大部分时间在等待，只限制在节点内浮动
+
+    static ThreadPlacement plan(const CpuTopology& topology) {
+        ThreadPlacement placement;
+        // 选 CPU 最多的节点，避免把所有线程挤在一个小节点上
+        const std::vector<int>* node = &topology.largestNode();
+        placement.reactorCpu = node->front();
+        placement.workerCpus.assign(node->size() > 1 ? node->begin() + 1 : node->begin(), node->end());
+        placement.blockingCpus = *node;
+        return placement;
+    }
+};
+
+// ServerConfig 汇总所有运行参数。优先级从低到高：内置默认值 < 配置文件 < 环境变量 < 命令行。
+//   配置文件：每行 "key = value"，'#' 开始注释，通过 --config=path 或 HTTPSERVER_CONFIG 指定
+//   环境变量：HTTPSERVER_ 加大写的键名，例如 HTTPSERVER_WORKER_THREADS=8
+//   命令行：--key=value；为了兼容旧的启动方式，第一个不带 -- 的参数仍然是端口
+// 线程数和 max_events 为 0 表示 auto，由 autoSize() 按 CPU 拓扑确定。
+struct ServerConfig {
+    int port = 8080;
+    std::vector<std::string> listen; // 额外的监听端点，写法见 Listener.h
+    int backlog = SOMAXCONN;
+    std::string tlsCert;
+    std::string tlsKey;
+
+    int maxEvents = 0;          // 单次 epoll_wait 返回事件数的上限，实际批大小在此范围内按负载调整
+    size_t readBufferSize = 4096;
+
+    size_t workerThreads = 0;
+    size_t workerQueue = 1024;
+    size_t blockingThreads = 0;
+    size_t blockingQueue = 256;
+    size_t dbThreads = 0;       // Database 中执行驱动调用的线程数
+    bool pinThreads = false;
+
+    bool busyPoll = false;          // 事件循环忙轮询，用空闲 CPU 换更低的尾延迟
+    int busyPollUsecs = 50;         // 客户端套接字的 SO_BUSY_POLL，0 表示不设置
+    int busyPollIdleMs = 200;       // 连续空闲多久后退回阻塞等待
+
+    int rateLimit = 0;              // 每个客户端每秒的请求数，0 表示不限制
+    int rateBurst = 0;              // 允许的突发请求数，0 时等于 rate_limit
+    size_t maxClientConnections = 0; // 每个客户端的并发连接数，0 表示不限制
+    // 可信反向代理的地址段（逗号分隔的 CIDR），它们转发的 X-Real-IP / X-Forwarded-For 用于区分客户端。
+    // nginx 经 docker 网络转发时需要加上它所在的网段，例如 127.0.0.0/8,::1,172.20.0.0/16
+    std::vector<std::string> trustedProxies = {"127.0.0.0/8", "::1"};
+
+    bool compression = true;         // 按 Accept-Encoding 对文本类响应做 gzip 压缩
+    int compressionLevel = 5;        // 1（最快）到 9（最小）
+    size_t compressionMinSize = 1024; // 小于该大小的响应体不压缩
+
+    std::string captureFile;          // 非空时开启抓包，见 Capture.h
+    size_t captureSample = 1;         // 每 N 个请求记录一个
+    size_t captureMaxSize = 1024 * 1024 * 1024; // 文件写到这个大小后停止记录
+
+    std::string mongoUri = "mongodb://172.20.0.2:27017";
+
+    // 按 默认值 -> 配置文件 -> 环境变量 -> 命令行 的顺序加载，出错时记录日志并返回 false
+    bool load(int argc, char* argv[]) {
+        std::string configFile;
+        if (const char* env = std::getenv("HTTPSERVER_CONFIG")) configFile = env;
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg.compare(0, 9, "--config=") == 0) configFile = arg.substr(9);
+        }
+        if (!configFile.empty() && !loadFile(configFile)) {
+            return false;
+        }
+        if (!loadEnv()) {
+            return false;
+        }
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            if (arg.compare(0, 2, "--") != 0) {
+                if (!set("port", arg)) return false;
+                continue;
+            }
+            size_t eq = arg.find('=');
+            if (eq == std::string::npos) {
+                if (!set(arg.substr(2), "true")) return false; // --pin_threads
+                continue;
+            }
+            std::string key = arg.substr(2, eq - 2);
+            if (key != "config" && !set(key, arg.substr(eq + 1))) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool loadFile(const std::string& path) {
+        std::ifstream file(path);
+        if (!file.is_open()) {
+            LOG_ERROR("Cannot open config file %s", path.c_str());
+            return false;
+        }
+        std::string line;
+        int lineNo = 0;
+        while (std::getline(file, line)) {
+            ++lineNo;
+            line = trim(line.substr(0, line.find('#')));
+            if (line.empty()) continue;
+            size_t eq = line.find('=');
+            if (eq == std::string::npos || !set(trim(line.substr(0, eq)), trim(line.substr(eq + 1)))) {
+                LOG_ERROR("Invalid config line %s:%d", path.c_str(), lineNo);
+                return false;
+            }
+        }
+        return true;
+    }
+
+    bool loadEnv() {
+        // 早先版本使用的变量名，优先级低于 HTTPSERVER_ 前缀的同名参数
+        static const char* legacy[][2] = {{"TLS_CERT", "tls_cert"}, {"TLS_KEY", "tls_key"}, {"LISTEN", "listen"}};
+        for (const auto& entry : legacy) {
+            const char* value = std::getenv(entry[0]);
+            if (value && !set(entry[1], value)) return false;
+        }
+        static const char* keys[] = {
+            "port", "listen", "backlog", "tls_cert", "tls_key", "max_events", "read_buffer_size",
+            "worker_threads", "worker_queue", "blocking_threads", "blocking_queue", "db_threads",
+            "pin_threads", "busy_poll", "busy_poll_usecs", "busy_poll_idle_ms",
+            "rate_limit", "rate_burst", "max_client_connections", "trusted_proxies",
+            "compression", "compression_level", "compression_min_size",
+            "capture_file", "capture_sample", "capture_max_size", "mongo_uri"
+        };
+        for (const char* key : keys) {
+            std::string name = "HTTPSERVER_" + std::string(key);
+            for (auto& c : name) c = toupper(c);
+            const char* value = std::getenv(name.c_str());
+            if (value && !set(key, value)) return false;
+        }
+        return true;
+    }
+
+    // 设置单个参数，未知的键或无法解析的值返回 false
+    bool set(const std::string& key, const std::string& value) {
+        bool ok = true;
+        if (key == "port") ok = parseInt(value, port);
+        else if (key == "listen") listen = splitList(value); // 逗号分隔
+        else if (key == "backlog") ok = parseInt(value, backlog);
+        else if (key == "tls_cert") tlsCert = value;
+        else if (key == "tls_key") tlsKey = value;
+        else if (key == "max_events") ok = parseInt(value, maxEvents);
+        else if (key == "read_buffer_size") ok = parseSize(value, readBufferSize) && readBufferSize > 0;
+        else if (key == "worker_threads") ok = parseSize(value, workerThreads);
+        else if (key == "worker_queue") ok = parseSize(value, workerQueue);
+        else if (key == "blocking_threads") ok = parseSize(value, blockingThreads);
+        else if (key == "blocking_queue") ok = parseSize(value, blockingQueue);
+        else if (key == "db_threads") ok = parseSize(value, dbThreads);
+        else if (key == "pin_threads") ok = parseBool(value, pinThreads);
+        else if (key == "busy_poll") ok = parseBool(value, busyPoll);
+        else if (key == "busy_poll_usecs") ok = parseInt(value, busyPollUsecs);
+        else if (key == "busy_poll_idle_ms") ok = parseInt(value, busyPollIdleMs);
+        else if (key == "rate_limit") ok = parseInt(value, rateLimit);
+        else if (key == "rate_burst") ok = parseInt(value, rateBurst);
+        else if (key == "max_client_connections") ok = parseSize(value, maxClientConnections);
+        else if (key == "trusted_proxies") trustedProxies = splitList(value);
+        else if (key == "compression") ok = parseBool(value, compression);
+        else if (key == "compression_level") ok = parseInt(value, compressionLevel) && compressionLevel >= 1 && compressionLevel <= 9;
+        else if (key == "compression_min_size") ok = parseSize(value, compressionMinSize);
+        else if (key == "capture_file") captureFile = value;
+        else if (key == "capture_sample") ok = parseSize(value, captureSample) && captureSample > 0;
+        else if (key == "capture_max_size") ok = parseSize(value, captureMaxSize);
+        else if (key == "mongo_uri") mongoUri = value;
+        else {
+            LOG_ERROR("Unknown config key: %s", key.c_str());
+            return false;
+        }
+        if (!ok) {
+            LOG_ERROR("Invalid value for %s: %s", key.c_str(), value.c_str());
+        }
+        return ok;
+    }
+
+    // 把 auto（0）参数换算成具体数值。
+    // WORKER 线程做的是 CPU 密集的解析和序列化，每个核一个，留出 I/O 线程的核；
+    // BLOCKING 和数据库线程大部分时间在等待网络，按核数的倍数放大。
+    // 绑核时线程只放在一个节点上（见 ThreadPlacement），按该节点的核数计算，否则多出的 WORKER 线程会两两挤在同一个核上
+    void autoSize(const CpuTopology& topology) {
+        size_t cpus = std::max<size_t>(1, pinThreads ? topology.largestNode().size() : topology.cpuCount());
+        if (workerThreads == 0) workerThreads = std::max<size_t>(1, cpus - 1);
+        if (blockingThreads == 0) blockingThreads = std::max<size_t>(8, cpus * 2);
+        if (dbThreads == 0) dbThreads = std::max<size_t>(4, cpus);
+        if (maxEvents <= 0) maxEvents = 256;
+    }
+
+    ExecutorConfig executorConfig() const {
+        ExecutorConfig config;
+        config.workerThreads = workerThreads;
+        config.workerQueue = workerQueue;
+        config.blockingThreads = blockingThreads;
+        config.blockingQueue = blockingQueue;
+        return config;
+    }
+
+    std::string toString() const {
+        std::ostringstream oss;
+        oss << "port=" << port << " listen=" << listen.size() << " backlog=" << backlog
+            << " tls=" << (tlsCert.empty() ? "off" : "on") << " max_events=" << maxEvents
+            << " read_buffer_size=" << readBufferSize << " worker_threads=" << workerThreads
+            << " worker_queue=" << workerQueue << " blocking_threads=" << blockingThreads
+            << " blocking_queue=" << blockingQueue << " db_threads=" << dbThreads
+            << " pin_threads=" << (pinThreads ? "true" : "false") << " busy_poll=" << (busyPoll ? "true" : "false")
+            << " rate_limit=" << rateLimit << " rate_burst=" << rateBurst
+            << " max_client_connections=" << maxClientConnections << " trusted_proxies=" << trustedProxies.size()
+            << " compression=" << (compression ? "true" : "false") << " compression_level=" << compressionLevel
+            << " compression_min_size=" << compressionMinSize
+            << " capture=" << (captureFile.empty() ? "off" : captureFile);
+        return oss.str();
+    }
+
+private:
+    static std::string trim(const std::string& s) {
+        size_t start = s.find_first_not_of(" \t\r");
+        if (start == std::string::npos) return "";
+        size_t end = s.find_last_not_of(" \t\r");
+        return s.substr(start, end - start + 1);
+    }
+
+    static std::vector<std::string> splitList(const std::string& value) {
+        std::vector<std::string> items;
+        std::stringstream ss(value);
+        std::string item;
+        while (std::getline(ss, item, ',')) {
+            item = trim(item);
+            if (!item.empty()) items.push_back(item);
+        }
+        return items;
+    }
+
+    static bool parseInt(const std::string& value, int& out) {
+        if (value == "auto") {
+            out = 0;
+            return true;
+        }
+        char* end = nullptr;
+        long v = std::strtol(value.c_str(), &end, 10);
+        if (value.empty() || *end != '\0' || v < 0) return false;
+        out = static_cast<int>(v);
+        return true;
+    }
+
+    // "auto" 等同于 0；支持 k/m 后缀，例如 read_buffer_size=16k
+    static bool parseSize(const std::string& value, size_t& out) {
+        if (value == "auto") {
+            out = 0;
+            return true;
+        }
+        char* end = nullptr;
+        unsigned long long v = std::strtoull(value.c_str(), &end, 10);
+        if (value.empty() || end == value.c_str()) return false;
+        if (*end == 'k' || *end == 'K') { v *= 1024; ++end; }
+        else if (*end == 'm' || *end == 'M') { v *= 1024 * 1024; ++end; }
+        if (*end != '\0') return false;
+        out = static_cast<size_t>(v);
+        return true;
+    }
+
+    static bool parseBool(const std::string& value, bool& out) {
+        if (value == "true" || value == "1" || value == "yes" || value == "on") out = true;
+        else if (value == "false" || value == "0" || value == "no" || value == "off") out = false;
+        else return false;
+        return true;
+    }
+};
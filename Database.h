@@ -1,41 +1,61 @@
 #ifndef DATABASE_H
 #define DATABASE_H
 
+// 编译时定义 HTTPSERVER_STUB_DATABASE 则换成不依赖 MongoDB 的内存实现，
+// 配合抓包回放（Capture.h、replay.cpp）在开发机上复现线上的性能问题
+#ifdef HTTPSERVER_STUB_DATABASE
+#include "StubDatabase.h"
+#else
+
 #include <mongocxx/client.hpp>
+#include <mongocxx/pool.hpp>
 #include <mongocxx/instance.hpp>
 #include <bsoncxx/builder/stream/document.hpp>
 #include <bsoncxx/json.hpp>
 #include <string>
-#include <future>
+#include <vector>
+#include <memory>
+#include <optional>
+#include <functional>
 #include <iostream> // 添加标准输出库
+#include "ThreadPool.h"
+#include "Task.h"
 
 class Database {
 private:
     mongocxx::instance instance{}; // 全局实例
-    mongocxx::client client;       // MongoDB 客户端
-    mongocxx::database db;         // 数据库
+    // mongocxx::client 不是线程安全的：driverPool 和 BLOCKING 线程池会同时访问数据库，
+    // 每次驱动调用（或每个游标）从连接池取一个客户端，用完归还。池大小由 uri 的 maxPoolSize 控制
+    mongocxx::pool pool;
+    ThreadPool driverPool;         // 专门执行阻塞驱动调用的小线程池，供协程接口使用
+
+    // 取一个客户端并返回 userdb 数据库；数据库对象依赖客户端，调用方必须让 client 活得更久
+    static mongocxx::database userdb(mongocxx::pool::entry& client) {
+        return (*client)["userdb"];
+    }
 
 public:
     // 构造函数
-    Database(const std::string& uri) {
+    Database(const std::string& uri, size_t driverThreads = 4)
+        : pool(mongocxx::uri{uri}), driverPool(driverThreads) {
         LOG_INFO("Connecting to MongoDB");
         std::cout << "Connecting to MongoDB at: " << uri << std::endl;
-        client = mongocxx::client{mongocxx::uri{uri}};
-        db = client["userdb"]; // 使用 userdb 数据库
     }
 
-    // 异步注册用户
-    std::future<bool> registerUserAsync(const std::string& username, const std::string& password) {
-        return std::async(std::launch::async, [this, username, password]() {
+    // 异步注册用户：驱动调用在 driverPool 中执行，协程挂起期间不占用线程
+    Task<bool> registerUserAsync(std::string username, std::string password) {
+        auto call = offload(driverPool, [this, username, password]() {
             return this->registerUser(username, password);
         });
+        co_return co_await call;
     }
 
     // 异步登录用户
-    std::future<bool> loginUserAsync(const std::string& username, const std::string& password) {
-        return std::async(std::launch::async, [this, username, password]() {
+    Task<bool> loginUserAsync(std::string username, std::string password) {
+        auto call = offload(driverPool, [this, username, password]() {
             return this->loginUser(username, password);
         });
+        co_return co_await call;
     }
 
     // 注册用户
@@ -45,7 +65,8 @@ public:
         bsoncxx::builder::stream::document document{};
         document << "username" << username << "password" << password;
 
-        auto collection = db["users"];
+        auto client = pool.acquire();
+        auto collection = userdb(client)["users"];
         bsoncxx::stdx::optional<mongocxx::result::insert_one> result = collection.insert_one(document.view());
 
         return result ? true : false;
@@ -54,7 +75,8 @@ public:
     // 登录用户
     bool loginUser(const std::string& username, const std::string& password) {
         LOG_INFO("User Login");
-        auto collection = db["users"];
+        auto client = pool.acquire();
+        auto collection = userdb(client)["users"];
         bsoncxx::builder::stream::document document{};
         document << "username" << username;
 
@@ -69,29 +91,111 @@ public:
     }
 
      // 存储图片信息
-    bool storeImage(const std::string& imageName, const std::string& imagePath, const std::string& description) {
+    // hash 为内容寻址存储中的 blob 键，同一内容的多次上传共享同一个 blob
+    bool storeImage(const std::string& imageName, const std::string& imagePath, const std::string& description,
+                    const std::string& hash = "") {
         bsoncxx::builder::stream::document document{};
         document << "name" << imageName
                  << "path" << imagePath
-                 << "description" << description;
+                 << "description" << description
+                 << "hash" << hash;
 
-        auto collection = db["images"];
+        auto client = pool.acquire();
+        auto collection = userdb(client)["images"];
         bsoncxx::stdx::optional<mongocxx::result::insert_one> result = collection.insert_one(document.view());
         return result ? true : false;
     }
 
+    // blob 引用计数加一，第一次引用时创建计数记录
+    bool acquireBlob(const std::string& key) {
+        using bsoncxx::builder::stream::open_document;
+        using bsoncxx::builder::stream::close_document;
+        bsoncxx::builder::stream::document filter{};
+        filter << "key" << key;
+        bsoncxx::builder::stream::document update{};
+        update << "$inc" << open_document << "refs" << 1 << close_document;
+
+        mongocxx::options::update options;
+        options.upsert(true);
+        auto client = pool.acquire();
+        auto collection = userdb(client)["blobs"];
+        auto result = collection.update_one(filter.view(), update.view(), options);
+        return result ? true : false;
+    }
+
+    // blob 引用计数减一；计数归零时删除计数记录。返回 true 表示记录确实被这次调用删除，调用方应删除文件。
+    // 删除带上 refs <= 0 的条件：减一和删除之间并发的 acquireBlob 会让计数重新变为正数，此时删除不匹配，文件保留
+    bool releaseBlob(const std::string& key) {
+        using bsoncxx::builder::stream::open_document;
+        using bsoncxx::builder::stream::close_document;
+        bsoncxx::builder::stream::document filter{};
+        filter << "key" << key;
+        bsoncxx::builder::stream::document update{};
+        update << "$inc" << open_document << "refs" << -1 << close_document;
+
+        auto client = pool.acquire();
+        auto collection = userdb(client)["blobs"];
+        if (!collection.update_one(filter.view(), update.view())) {
+            return false;
+        }
+        bsoncxx::builder::stream::document drained{};
+        drained << "key" << key << "refs" << open_document << "$lte" << 0 << close_document;
+        auto deleted = collection.delete_one(drained.view());
+        return deleted && deleted->deleted_count() > 0;
+    }
+
     // 获取图片列表
     std::vector<std::string> getImageList() {
         std::vector<std::string> images;
-        auto collection = db["images"];
+        auto client = pool.acquire();
+        auto collection = userdb(client)["images"];
         auto cursor = collection.find({});
         for (auto&& doc : cursor) {
             images.push_back(doc["path"].get_utf8().value.to_string());
         }
         return images;
     }
+
+    // 以下异步版本在 driverPool 中执行，供上传协程使用
+    Task<bool> storeImageAsync(std::string imageName, std::string imagePath, std::string description, std::string hash) {
+        auto call = offload(driverPool, [=, this]() {
+            return this->storeImage(imageName, imagePath, description, hash);
+        });
+        co_return co_await call;
+    }
+
+    // 以游标方式逐条读取图片路径，返回 false 表示已经读完。
+    // 查询在第一次调用时才真正发出，适合在阻塞线程池中驱动流式响应。
+    // limit 作为查询选项交给服务端，SIZE_MAX 表示不限
+    std::function<bool(std::string&)> openImagePathStream(size_t limit = SIZE_MAX) {
+        // 游标在整个流式响应期间都要用到它的客户端，client 声明在 cursor 之前，析构时最后释放
+        struct State {
+            mongocxx::pool::entry client;
+            std::optional<mongocxx::cursor> cursor;
+            mongocxx::cursor::iterator it;
+        };
+        auto state = std::make_shared<State>();
+        return [this, state, limit](std::string& path) {
+            if (!state->cursor) {
+                mongocxx::options::find options;
+                if (limit < static_cast<size_t>(INT64_MAX)) {
+                    options.limit(static_cast<int64_t>(limit));
+                }
+                state->client = pool.acquire();
+                state->cursor.emplace(userdb(state->client)["images"].find({}, options));
+                state->it = state->cursor->begin();
+            }
+            if (state->it == state->cursor->end()) {
+                return false;
+            }
+            path = (*state->it)["path"].get_utf8().value.to_string();
+            ++state->it;
+            return true;
+        };
+    }
 };
 
+#endif // HTTPSERVER_STUB_DATABASE
 #endif // DATABASE_H
 
 
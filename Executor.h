@@ -0,0 +1,57 @@
+#pragma once
+#include "ThreadPool.h"
+#include <functional>
+#include <memory>
+#include <vector>
+
+// 路由的执行类别，在 Router::addRoute 时声明
+enum class ExecClass {
+    INLINE,   // 直接在 I/O 线程上执行，只适用于不会阻塞的内存型处理函数
+    WORKER,   // 通用工作线程池，适合读静态文件、解析表单等短耗时任务
+    BLOCKING  // 阻塞线程池，专门用于数据库等可能长时间阻塞的处理函数
+};
+
+// 各执行类别的线程数和队列上限，彼此独立配置
+struct ExecutorConfig {
+    size_t workerThreads = 4;
+    size_t workerQueue = 1024;
+    size_t blockingThreads = 16;
+    size_t blockingQueue = 256;
+};
+
+// Executors 持有按执行类别划分的线程池。
+// 数据库变慢时只会占满 BLOCKING 池，WORKER 池和 I/O 线程上的路由不受影响。
+class Executors {
+public:
+    explicit Executors(const ExecutorConfig& config = ExecutorConfig())
+        : workerPool(config.workerThreads, config.workerQueue),
+          blockingPool(config.blockingThreads, config.blockingQueue) {}
+
+    // 按执行类别派发任务；INLINE 在调用线程上直接执行。
+    // 对应线程池队列已满时返回 false，任务不会被执行。
+    bool dispatch(ExecClass exec, std::function<void()> task) {
+        switch (exec) {
+            case ExecClass::INLINE:
+                task();
+                return true;
+            case ExecClass::WORKER:
+                return workerPool.tryEnqueue(std::move(task));
+            case ExecClass::BLOCKING:
+                return blockingPool.tryEnqueue(std::move(task));
+        }
+        return false;
+    }
+
+    // WORKER 线程逐个绑核，BLOCKING 线程限制在给定的核集合内
+    void setAffinity(const std::vector<int>& workerCpus, const std::vector<int>& blockingCpus) {
+        workerPool.setAffinity(workerCpus, true);
+        blockingPool.setAffinity(blockingCpus, false);
+    }
+
+    ThreadPool& worker() { return workerPool; }
+    ThreadPool& blocking() { return blockingPool; }
+
+private:
+    ThreadPool workerPool;
+    ThreadPool blockingPool;
+};
@@ -0,0 +1,82 @@
+#pragma once
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// 已打开的文件及其 stat 信息。析构时关闭 fd，
+// 因此被 LRU 淘汰时正在 sendfile 的连接仍然持有有效的 fd。
+struct OpenFile {
+    int fd = -1;
+    struct stat st {};
+
+    ~OpenFile() {
+        if (fd >= 0) close(fd);
+    }
+};
+
+// FileCache 按路径缓存打开的文件描述符和 stat 结果，避免每个请求都 open/fstat。
+// 容量按条目数计算，超过后淘汰最久未使用的条目。
+class FileCache {
+public:
+    explicit FileCache(size_t capacity = 256) : capacity(capacity) {}
+
+    // 返回缓存中的文件，未命中时打开并加入缓存；文件不存在或不是普通文件时返回 nullptr
+    std::shared_ptr<const OpenFile> open(const std::string& path) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = index.find(path);
+            if (it != index.end()) {
+                lru.splice(lru.begin(), lru, it->second); // 移到最近使用的位置
+                return it->second->second;
+            }
+        }
+
+        // 在锁外执行 open/fstat，避免慢磁盘阻塞其他命中缓存的请求
+        auto file = std::make_shared<OpenFile>();
+        file->fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (file->fd < 0) {
+            return nullptr;
+        }
+        if (fstat(file->fd, &file->st) != 0 || !S_ISREG(file->st.st_mode)) {
+            return nullptr;
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(path);
+        if (it != index.end()) {
+            // 其他线程已经抢先放入，使用已有条目
+            lru.splice(lru.begin(), lru, it->second);
+            return it->second->second;
+        }
+        lru.emplace_front(path, file);
+        index[path] = lru.begin();
+        if (lru.size() > capacity) {
+            index.erase(lru.back().first);
+            lru.pop_back();
+        }
+        return file;
+    }
+
+    // 文件被覆盖或删除后调用，使下次访问重新打开
+    void invalidate(const std::string& path) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(path);
+        if (it != index.end()) {
+            lru.erase(it->second);
+            index.erase(it);
+        }
+    }
+
+private:
+    using Entry = std::pair<std::string, std::shared_ptr<const OpenFile>>;
+
+    size_t capacity;
+    std::list<Entry> lru; // 头部为最近使用
+    std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    std::mutex mutex;
+};
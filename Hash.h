@@ -0,0 +1,144 @@
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+
+// XXH64：快速的非加密 64 位哈希，用于内容寻址存储和缓存键。
+// 支持增量计算，可以在接收数据的同时更新哈希值，不需要一次性拿到全部内容。
+class XXHash64 {
+public:
+    explicit XXHash64(uint64_t seed = 0) : seed(seed) {
+        v[0] = seed + PRIME1 + PRIME2;
+        v[1] = seed + PRIME2;
+        v[2] = seed;
+        v[3] = seed - PRIME1;
+    }
+
+    void update(const void* data, size_t len) {
+        const unsigned char* p = static_cast<const unsigned char*>(data);
+        totalLen += len;
+
+        // 先补齐上次剩下的不足 32 字节的数据
+        if (bufferSize + len < 32) {
+            memcpy(buffer + bufferSize, p, len);
+            bufferSize += len;
+            return;
+        }
+        if (bufferSize > 0) {
+            size_t fill = 32 - bufferSize;
+            memcpy(buffer + bufferSize, p, fill);
+            processStripe(buffer);
+            p += fill;
+            len -= fill;
+            bufferSize = 0;
+        }
+        while (len >= 32) {
+            processStripe(p);
+            p += 32;
+            len -= 32;
+        }
+        memcpy(buffer, p, len);
+        bufferSize = len;
+    }
+
+    void update(const std::string& data) {
+        update(data.data(), data.size());
+    }
+
+    uint64_t digest() const {
+        uint64_t h;
+        if (totalLen >= 32) {
+            h = rotl(v[0], 1) + rotl(v[1], 7) + rotl(v[2], 12) + rotl(v[3], 18);
+            for (int i = 0; i < 4; ++i) {
+                h = (h ^ round(0, v[i])) * PRIME1 + PRIME4;
+            }
+        } else {
+            h = seed + PRIME5;
+        }
+        h += totalLen;
+
+        const unsigned char* p = buffer;
+        size_t len = bufferSize;
+        while (len >= 8) {
+            h ^= round(0, read64(p));
+            h = rotl(h, 27) * PRIME1 + PRIME4;
+            p += 8;
+            len -= 8;
+        }
+        if (len >= 4) {
+            h ^= static_cast<uint64_t>(read32(p)) * PRIME1;
+            h = rotl(h, 23) * PRIME2 + PRIME3;
+            p += 4;
+            len -= 4;
+        }
+        while (len > 0) {
+            h ^= (*p) * PRIME5;
+            h = rotl(h, 11) * PRIME1;
+            ++p;
+            --len;
+        }
+
+        h ^= h >> 33;
+        h *= PRIME2;
+        h ^= h >> 29;
+        h *= PRIME3;
+        h ^= h >> 32;
+        return h;
+    }
+
+    static uint64_t hash(const void* data, size_t len, uint64_t seed = 0) {
+        XXHash64 hasher(seed);
+        hasher.update(data, len);
+        return hasher.digest();
+    }
+
+    // 16 位小写十六进制表示，用作文件名或缓存键
+    static std::string toHex(uint64_t h) {
+        char out[17];
+        snprintf(out, sizeof(out), "%016llx", static_cast<unsigned long long>(h));
+        return out;
+    }
+
+private:
+    static constexpr uint64_t PRIME1 = 11400714785074694791ULL;
+    static constexpr uint64_t PRIME2 = 14029467366897019727ULL;
+    static constexpr uint64_t PRIME3 = 1609587929392839161ULL;
+    static constexpr uint64_t PRIME4 = 9650029242287828579ULL;
+    static constexpr uint64_t PRIME5 = 2870177450012600261ULL;
+
+    static uint64_t rotl(uint64_t x, int r) {
+        return (x << r) | (x >> (64 - r));
+    }
+
+    static uint64_t read64(const unsigned char* p) {
+        uint64_t v;
+        memcpy(&v, p, sizeof(v));
+        return v; // 假定小端序（x86/ARM Linux）
+    }
+
+    static uint32_t read32(const unsigned char* p) {
+        uint32_t v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static uint64_t round(uint64_t acc, uint64_t input) {
+        acc += input * PRIME2;
+        acc = rotl(acc, 31);
+        return acc * PRIME1;
+    }
+
+    void processStripe(const unsigned char* p) {
+        v[0] = round(v[0], read64(p));
+        v[1] = round(v[1], read64(p + 8));
+        v[2] = round(v[2], read64(p + 16));
+        v[3] = round(v[3], read64(p + 24));
+    }
+
+    uint64_t seed;
+    uint64_t v[4];
+    unsigned char buffer[32];
+    size_t bufferSize = 0;
+    uint64_t totalLen = 0;
+};
@@ -0,0 +1,377 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+// HPACK（RFC 7541）头部压缩：静态表、动态表、Huffman 解码，以及 HTTP/2 会话使用的编解码器。
+
+struct HeaderField {
+    std::string name;
+    std::string value;
+};
+
+// 静态表 + 动态表的统一索引空间，索引从 1 开始：1..61 为静态表，之后为动态表（最新的在前）
+class HpackTable {
+public:
+    static const std::vector<HeaderField>& staticTable() {
+        static const std::vector<HeaderField> table = {
+        {":authority", ""}, {":method", "GET"}, {":method", "POST"}, {":path", "/"},
+        {":path", "/index.html"}, {":scheme", "http"}, {":scheme", "https"}, {":status", "200"},
+        {":status", "204"}, {":status", "206"}, {":status", "304"}, {":status", "400"}, {":status", "404"},
+        {":status", "500"}, {"accept-charset", ""}, {"accept-encoding", "gzip, deflate"},
+        {"accept-language", ""}, {"accept-ranges", ""}, {"accept", ""}, {"access-control-allow-origin", ""},
+        {"age", ""}, {"allow", ""}, {"authorization", ""}, {"cache-control", ""},
+        {"content-disposition", ""}, {"content-encoding", ""}, {"content-language", ""},
+        {"content-length", ""}, {"content-location", ""}, {"content-range", ""}, {"content-type", ""},
+        {"cookie", ""}, {"date", ""}, {"etag", ""}, {"expect", ""}, {"expires", ""}, {"from", ""},
+        {"host", ""}, {"if-match", ""}, {"if-modified-since", ""}, {"if-none-match", ""}, {"if-range", ""},
+        {"if-unmodified-since", ""}, {"last-modified", ""}, {"link", ""}, {"location", ""},
+        {"max-forwards", ""}, {"proxy-authenticate", ""}, {"proxy-authorization", ""}, {"range", ""},
+        {"referer", ""}, {"refresh", ""}, {"retry-after", ""}, {"server", ""}, {"set-cookie", ""},
+        {"strict-transport-security", ""}, {"transfer-encoding", ""}, {"user-agent", ""}, {"vary", ""},
+        {"via", ""}, {"www-authenticate", ""},
+        };
+        return table;
+    }
+
+    bool get(size_t index, HeaderField& out) const {
+        const auto& st = staticTable();
+        if (index == 0) return false;
+        if (index <= st.size()) {
+            out = st[index - 1];
+            return true;
+        }
+        index -= st.size() + 1;
+        if (index >= dynamic.size()) return false;
+        out = dynamic[index];
+        return true;
+    }
+
+    // 查找头部字段，返回索引（0 表示没找到）；exact 表示名称和值都匹配
+    size_t find(const std::string& name, const std::string& value, bool& exact) const {
+        const auto& st = staticTable();
+        size_t nameIndex = 0;
+        exact = false;
+        for (size_t i = 0; i < st.size(); ++i) {
+            if (st[i].name == name) {
+                if (st[i].value == value) {
+                    exact = true;
+                    return i + 1;
+                }
+                if (nameIndex == 0) nameIndex = i + 1;
+            }
+        }
+        for (size_t i = 0; i < dynamic.size(); ++i) {
+            if (dynamic[i].name == name) {
+                if (dynamic[i].value == value) {
+                    exact = true;
+                    return st.size() + i + 1;
+                }
+                if (nameIndex == 0) nameIndex = st.size() + i + 1;
+            }
+        }
+        return nameIndex;
+    }
+
+    void add(const std::string& name, const std::string& value) {
+        size_t entrySize = name.size() + value.size() + 32; // RFC 7541 4.1 规定的条目开销
+        if (entrySize > maxSize) {
+            // 大于整个表的条目会清空动态表，且自身不会被加入
+            dynamic.clear();
+            size = 0;
+            return;
+        }
+        while (size + entrySize > maxSize) evictOldest();
+        dynamic.push_front(HeaderField{name, value});
+        size += entrySize;
+    }
+
+    void setMaxSize(size_t newSize) {
+        maxSize = newSize;
+        while (size > maxSize) evictOldest();
+    }
+
+    size_t getMaxSize() const {
+        return maxSize;
+    }
+
+private:
+    void evictOldest() {
+        const auto& last = dynamic.back();
+        size -= last.name.size() + last.value.size() + 32;
+        dynamic.pop_back();
+    }
+
+    std::deque<HeaderField> dynamic;
+    size_t size = 0;
+    size_t maxSize = 4096;
+};
+
+// HPACK 的 Huffman 编码（RFC 7541 附录 B），启动时把码表构造成二叉解码树
+class HpackHuffman {
+public:
+    static bool decode(const uint8_t* data, size_t len, std::string& out) {
+        const Tree& tree = decodeTree();
+        int node = 0;
+        int bitsSinceSymbol = 0;
+        bool allOnes = true;
+        for (size_t i = 0; i < len; ++i) {
+            for (int bit = 7; bit >= 0; --bit) {
+                int b = (data[i] >> bit) & 1;
+                node = tree.children[node][b];
+                if (node < 0) return false;
+                ++bitsSinceSymbol;
+                allOnes = allOnes && b == 1;
+                int sym = tree.symbol[node];
+                if (sym >= 0) {
+                    if (sym == 256) return false; // 不允许出现 EOS
+                    out += static_cast<char>(sym);
+                    node = 0;
+                    bitsSinceSymbol = 0;
+                    allOnes = true;
+                }
+            }
+        }
+        // 结尾的填充必须是不超过 7 位的全 1（EOS 的前缀）
+        return bitsSinceSymbol <= 7 && allOnes;
+    }
+
+private:
+    struct Tree {
+        std::vector<int> symbol;             // 叶子节点对应的符号，非叶子为 -1
+        std::vector<std::array<int, 2>> children;
+    };
+
+    static const Tree& decodeTree() {
+        static const Tree tree = [] {
+            Tree t;
+            t.symbol.push_back(-1);
+            t.children.push_back({-1, -1});
+            for (int sym = 0; sym <= 256; ++sym) {
+                uint32_t code = sym == 256 ? 0x3fffffff : huffmanCodes[sym];
+                int len = sym == 256 ? 30 : huffmanCodeLen[sym];
+                int node = 0;
+                for (int i = len - 1; i >= 0; --i) {
+                    int b = (code >> i) & 1;
+                    if (t.children[node][b] < 0) {
+                        t.children[node][b] = static_cast<int>(t.symbol.size());
+                        t.symbol.push_back(-1);
+                        t.children.push_back({-1, -1});
+                    }
+                    node = t.children[node][b];
+                }
+                t.symbol[node] = sym;
+            }
+            return t;
+        }();
+        return tree;
+    }
+
+    static constexpr uint32_t huffmanCodes[256] = {
+        0x1ff8, 0x7fffd8, 0xfffffe2, 0xfffffe3, 0xfffffe4, 0xfffffe5, 0xfffffe6, 0xfffffe7,
+        0xfffffe8, 0xffffea, 0x3ffffffc, 0xfffffe9, 0xfffffea, 0x3ffffffd, 0xfffffeb, 0xfffffec,
+        0xfffffed, 0xfffffee, 0xfffffef, 0xffffff0, 0xffffff1, 0xffffff2, 0x3ffffffe, 0xffffff3,
+        0xffffff4, 0xffffff5, 0xffffff6, 0xffffff7, 0xffffff8, 0xffffff9, 0xffffffa, 0xffffffb,
+        0x14, 0x3f8, 0x3f9, 0xffa, 0x1ff9, 0x15, 0xf8, 0x7fa,
+        0x3fa, 0x3fb, 0xf9, 0x7fb, 0xfa, 0x16, 0x17, 0x18,
+        0x0, 0x1, 0x2, 0x19, 0x1a, 0x1b, 0x1c, 0x1d,
+        0x1e, 0x1f, 0x5c, 0xfb, 0x7ffc, 0x20, 0xffb, 0x3fc,
+        0x1ffa, 0x21, 0x5d, 0x5e, 0x5f, 0x60, 0x61, 0x62,
+        0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6a,
+        0x6b, 0x6c, 0x6d, 0x6e, 0x6f, 0x70, 0x71, 0x72,
+        0xfc, 0x73, 0xfd, 0x1ffb, 0x7fff0, 0x1ffc, 0x3ffc, 0x22,
+        0x7ffd, 0x3, 0x23, 0x4, 0x24, 0x5, 0x25, 0x26,
+        0x27, 0x6, 0x74, 0x75, 0x28, 0x29, 0x2a, 0x7,
+        0x2b, 0x76, 0x2c, 0x8, 0x9, 0x2d, 0x77, 0x78,
+        0x79, 0x7a, 0x7b, 0x7ffe, 0x7fc, 0x3ffd, 0x1ffd, 0xffffffc,
+        0xfffe6, 0x3fffd2, 0xfffe7, 0xfffe8, 0x3fffd3, 0x3fffd4, 0x3fffd5, 0x7fffd9,
+        0x3fffd6, 0x7fffda, 0x7fffdb, 0x7fffdc, 0x7fffdd, 0x7fffde, 0xffffeb, 0x7fffdf,
+        0xffffec, 0xffffed, 0x3fffd7, 0x7fffe0, 0xffffee, 0x7fffe1, 0x7fffe2, 0x7fffe3,
+        0x7fffe4, 0x1fffdc, 0x3fffd8, 0x7fffe5, 0x3fffd9, 0x7fffe6, 0x7fffe7, 0xffffef,
+        0x3fffda, 0x1fffdd, 0xfffe9, 0x3fffdb, 0x3fffdc, 0x7fffe8, 0x7fffe9, 0x1fffde,
+        0x7fffea, 0x3fffdd, 0x3fffde, 0xfffff0, 0x1fffdf, 0x3fffdf, 0x7fffeb, 0x7fffec,
+        0x1fffe0, 0x1fffe1, 0x3fffe0, 0x1fffe2, 0x7fffed, 0x3fffe1, 0x7fffee, 0x7fffef,
+        0xfffea, 0x3fffe2, 0x3fffe3, 0x3fffe4, 0x7ffff0, 0x3fffe5, 0x3fffe6, 0x7ffff1,
+        0x3ffffe0, 0x3ffffe1, 0xfffeb, 0x7fff1, 0x3fffe7, 0x7ffff2, 0x3fffe8, 0x1ffffec,
+        0x3ffffe2, 0x3ffffe3, 0x3ffffe4, 0x7ffffde, 0x7ffffdf, 0x3ffffe5, 0xfffff1, 0x1ffffed,
+        0x7fff2, 0x1fffe3, 0x3ffffe6, 0x7ffffe0, 0x7ffffe1, 0x3ffffe7, 0x7ffffe2, 0xfffff2,
+        0x1fffe4, 0x1fffe5, 0x3ffffe8, 0x3ffffe9, 0xffffffd, 0x7ffffe3, 0x7ffffe4, 0x7ffffe5,
+        0xfffec, 0xfffff3, 0xfffed, 0x1fffe6, 0x3fffe9, 0x1fffe7, 0x1fffe8, 0x7ffff3,
+        0x3fffea, 0x3fffeb, 0x1ffffee, 0x1ffffef, 0xfffff4, 0xfffff5, 0x3ffffea, 0x7ffff4,
+        0x3ffffeb, 0x7ffffe6, 0x3ffffec, 0x3ffffed, 0x7ffffe7, 0x7ffffe8, 0x7ffffe9, 0x7ffffea,
+        0x7ffffeb, 0xffffffe, 0x7ffffec, 0x7ffffed, 0x7ffffee, 0x7ffffef, 0x7fffff0, 0x3ffffee,
+    };
+    static constexpr uint8_t huffmanCodeLen[256] = {
+        13, 23, 28, 28, 28, 28, 28, 28, 28, 24, 30, 28, 28, 30, 28, 28,
+        28, 28, 28, 28, 28, 28, 30, 28, 28, 28, 28, 28, 28, 28, 28, 28,
+        6, 10, 10, 12, 13, 6, 8, 11, 10, 10, 8, 11, 8, 6, 6, 6,
+        5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 7, 8, 15, 6, 12, 10,
+        13, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7,
+        7, 7, 7, 7, 7, 7, 7, 7, 8, 7, 8, 13, 19, 13, 14, 6,
+        15, 5, 6, 5, 6, 5, 6, 6, 6, 5, 7, 7, 6, 6, 6, 5,
+        6, 7, 6, 5, 5, 6, 7, 7, 7, 7, 7, 15, 11, 14, 13, 28,
+        20, 22, 20, 20, 22, 22, 22, 23, 22, 23, 23, 23, 23, 23, 24, 23,
+        24, 24, 22, 23, 24, 23, 23, 23, 23, 21, 22, 23, 22, 23, 23, 24,
+        22, 21, 20, 22, 22, 23, 23, 21, 23, 22, 22, 24, 21, 22, 23, 23,
+        21, 21, 22, 21, 23, 22, 23, 23, 20, 22, 22, 22, 23, 22, 22, 23,
+        26, 26, 20, 19, 22, 23, 22, 25, 26, 26, 26, 27, 27, 26, 24, 25,
+        19, 21, 26, 27, 27, 26, 27, 24, 21, 21, 26, 26, 28, 27, 27, 27,
+        20, 24, 20, 21, 22, 21, 21, 23, 22, 22, 25, 25, 24, 24, 26, 23,
+        26, 27, 26, 26, 27, 27, 27, 27, 27, 28, 27, 27, 27, 27, 27, 26,
+    };
+};
+
+// 头部块解码器，动态表在整个连接内共享
+class HpackDecoder {
+public:
+    // 对端 SETTINGS_HEADER_TABLE_SIZE 之外，本端允许的动态表上限
+    explicit HpackDecoder(size_t maxTableSize = 4096) : maxTableSize(maxTableSize) {}
+
+    bool decode(const uint8_t* p, size_t len, std::vector<HeaderField>& out) {
+        const uint8_t* end = p + len;
+        while (p < end) {
+            uint8_t b = *p;
+            if (b & 0x80) {
+                // 6.1 索引头部字段
+                uint64_t index;
+                if (!decodeInt(p, end, 7, index)) return false;
+                HeaderField field;
+                if (!table.get(index, field)) return false;
+                out.push_back(std::move(field));
+            } else if ((b & 0xC0) == 0x40) {
+                // 6.2.1 带增量索引的字面量
+                HeaderField field;
+                if (!decodeLiteral(p, end, 6, field)) return false;
+                table.add(field.name, field.value);
+                out.push_back(std::move(field));
+            } else if ((b & 0xE0) == 0x20) {
+                // 6.3 动态表大小更新
+                uint64_t size;
+                if (!decodeInt(p, end, 5, size) || size > maxTableSize) return false;
+                table.setMaxSize(size);
+            } else {
+                // 6.2.2 不索引 / 6.2.3 永不索引的字面量
+                HeaderField field;
+                if (!decodeLiteral(p, end, 4, field)) return false;
+                out.push_back(std::move(field));
+            }
+        }
+        return true;
+    }
+
+private:
+    static bool decodeInt(const uint8_t*& p, const uint8_t* end, int prefix, uint64_t& value) {
+        if (p >= end) return false;
+        uint64_t max = (1u << prefix) - 1;
+        value = *p++ & max;
+        if (value < max) return true;
+        int shift = 0;
+        while (p < end) {
+            uint8_t b = *p++;
+            value += static_cast<uint64_t>(b & 0x7F) << shift;
+            if ((b & 0x80) == 0) return true;
+            shift += 7;
+            if (shift > 56) return false;
+        }
+        return false;
+    }
+
+    static bool decodeString(const uint8_t*& p, const uint8_t* end, std::string& out) {
+        if (p >= end) return false;
+        bool huffman = (*p & 0x80) != 0;
+        uint64_t len;
+        if (!decodeInt(p, end, 7, len) || len > static_cast<uint64_t>(end - p)) return false;
+        if (huffman) {
+            if (!HpackHuffman::decode(p, len, out)) return false;
+        } else {
+            out.assign(reinterpret_cast<const char*>(p), len);
+        }
+        p += len;
+        return true;
+    }
+
+    bool decodeLiteral(const uint8_t*& p, const uint8_t* end, int prefix, HeaderField& field) {
+        uint64_t index;
+        if (!decodeInt(p, end, prefix, index)) return false;
+        if (index == 0) {
+            if (!decodeString(p, end, field.name)) return false;
+        } else {
+            HeaderField named;
+            if (!table.get(index, named)) return false;
+            field.name = named.name;
+        }
+        return decodeString(p, end, field.value);
+    }
+
+    HpackTable table;
+    size_t maxTableSize;
+};
+
+// 头部块编码器。字符串不做 Huffman 编码（协议允许），重复出现的头部通过动态表压缩成一个字节；
+// 每次响应都会变化或者敏感的头部不进入动态表，避免无效的表项挤掉有用的条目。
+class HpackEncoder {
+public:
+    // 对端通过 SETTINGS_HEADER_TABLE_SIZE 限制动态表大小，下一个头部块开头需要告知
+    void setMaxTableSize(size_t size) {
+        if (size < table.getMaxSize()) {
+            table.setMaxSize(size);
+            pendingSizeUpdate = true;
+        }
+    }
+
+    void encode(const std::vector<HeaderField>& fields, std::string& out) {
+        if (pendingSizeUpdate) {
+            encodeInt(out, 0x20, 5, table.getMaxSize());
+            pendingSizeUpdate = false;
+        }
+        for (const auto& field : fields) {
+            bool exact;
+            size_t index = table.find(field.name, field.value, exact);
+            if (exact) {
+                encodeInt(out, 0x80, 7, index);
+                continue;
+            }
+            if (field.name == "set-cookie" || field.name == "authorization") {
+                encodeInt(out, 0x10, 4, index); // 永不索引
+            } else if (!shouldIndex(field.name)) {
+                encodeInt(out, 0x00, 4, index); // 不索引
+            } else {
+                encodeInt(out, 0x40, 6, index); // 增量索引
+                table.add(field.name, field.value);
+            }
+            if (index == 0) encodeString(out, field.name);
+            encodeString(out, field.value);
+        }
+    }
+
+private:
+    static bool shouldIndex(const std::string& name) {
+        return name != "content-length" && name != "content-range" && name != "date" &&
+               name != "etag" && name != "last-modified";
+    }
+
+    static void encodeInt(std::string& out, uint8_t flags, int prefix, uint64_t value) {
+        uint64_t max = (1u << prefix) - 1;
+        if (value < max) {
+            out += static_cast<char>(flags | value);
+            return;
+        }
+        out += static_cast<char>(flags | max);
+        value -= max;
+        while (value >= 128) {
+            out += static_cast<char>((value & 0x7F) | 0x80);
+            value >>= 7;
+        }
+        out += static_cast<char>(value);
+    }
+
+    static void encodeString(std::string& out, const std::string& s) {
+        encodeInt(out, 0x00, 7, s.size());
+        out += s;
+    }
+
+    HpackTable table;
+    bool pendingSizeUpdate = false;
+};
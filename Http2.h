@@ -0,0 +1,749 @@
+#pragma once
+#include "Hpack.h"
+#include "HttpRequest.h"
+#include "HttpResponse.h"
+#include "Logger.h"
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Http2Session 是单个连接上的 HTTP/2（h2c）协议状态机，不直接接触套接字：
+// 服务器把读到的字节交给 receive()，取走 takeRequests() 解析出的完整请求派发到 Router，
+// 处理完成后用 submitResponse() 提交响应，再把 takeOutput() 得到的帧写回套接字。
+// 多个流共享同一个连接，按流和连接两级流量控制交替发送 DATA 帧，慢请求不会阻塞其他流。
+// 调用方负责串行化对同一个会话的访问（服务器在 connectionsMutex 下调用）。
+class Http2Session {
+public:
+    static constexpr const char* PREFACE = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+    static constexpr size_t PREFACE_SIZE = 24;
+
+    // 本端通告的参数
+    static constexpr uint32_t MAX_CONCURRENT_STREAMS = 100;
+    static constexpr uint32_t LOCAL_INITIAL_WINDOW = 1024 * 1024;
+    static constexpr uint32_t LOCAL_MAX_FRAME_SIZE = 16384;
+    // 连接级接收窗口只在请求体交给服务器（或被丢弃）之后才归还，所以它也是一个连接上缓存的请求体总量上限。
+    // 比请求体上限多一个流窗口，超过上限的请求体能够被收到并回应 413，而不是卡在窗口上
+    static constexpr uint32_t LOCAL_CONNECTION_WINDOW = HttpRequest::MAX_BODY_SIZE + LOCAL_INITIAL_WINDOW;
+
+    Http2Session() {
+        // 服务器连接前言：SETTINGS，并把连接级接收窗口扩大到 LOCAL_CONNECTION_WINDOW，方便上传
+        std::string settings;
+        appendSetting(settings, SETTINGS_MAX_CONCURRENT_STREAMS, MAX_CONCURRENT_STREAMS);
+        appendSetting(settings, SETTINGS_INITIAL_WINDOW_SIZE, LOCAL_INITIAL_WINDOW);
+        writeFrame(FRAME_SETTINGS, 0, 0, settings);
+        sendWindowUpdate(0, LOCAL_CONNECTION_WINDOW - DEFAULT_WINDOW);
+    }
+
+    // 客户端连接前言的前缀，用于在第一批数据上识别 prior-knowledge 方式的 h2c
+    static bool hasPreface(const std::string& buffer) {
+        size_t n = std::min(buffer.size(), PREFACE_SIZE);
+        return n > 0 && buffer.compare(0, n, PREFACE, n) == 0;
+    }
+
+    // HTTP/1.1 "Upgrade: h2c" 升级：HTTP2-Settings 头部携带客户端的 SETTINGS 负载，
+    // 升级前的请求成为流 1，它的请求方向已经结束
+    bool acceptUpgrade(const std::string& settingsHeader, std::shared_ptr<HttpRequest> request) {
+        std::string payload;
+        if (!base64UrlDecode(settingsHeader, payload) || payload.size() % 6 != 0 ||
+            applySettings(payload.data(), payload.size()) != NO_ERROR) {
+            return false;
+        }
+        lastStreamId = 1;
+        Stream& stream = streams[1];
+        stream.sendWindow = peerInitialWindow;
+        stream.remoteClosed = true;
+        readyRequests.emplace_back(1, std::move(request));
+        return true;
+    }
+
+    // 处理收到的字节，返回 false 表示出现连接错误（GOAWAY 已放入输出）
+    bool receive(const char* data, size_t len) {
+        if (goawaySent) {
+            return false;
+        }
+        input.append(data, len);
+        size_t pos = 0;
+        if (!prefaceReceived) {
+            if (input.size() < PREFACE_SIZE) {
+                return true;
+            }
+            if (input.compare(0, PREFACE_SIZE, PREFACE) != 0) {
+                goAway(PROTOCOL_ERROR);
+                return false;
+            }
+            prefaceReceived = true;
+            pos = PREFACE_SIZE;
+        }
+
+        while (input.size() - pos >= FRAME_HEADER_SIZE) {
+            const uint8_t* h = reinterpret_cast<const uint8_t*>(input.data() + pos);
+            uint32_t length = (h[0] << 16) | (h[1] << 8) | h[2];
+            uint8_t type = h[3];
+            uint8_t flags = h[4];
+            uint32_t streamId = ((h[5] << 24) | (h[6] << 16) | (h[7] << 8) | h[8]) & 0x7FFFFFFF;
+            if (length > LOCAL_MAX_FRAME_SIZE) {
+                goAway(FRAME_SIZE_ERROR);
+                return false;
+            }
+            if (input.size() - pos - FRAME_HEADER_SIZE < length) {
+                break; // 帧还没有收齐
+            }
+            const uint8_t* payload = h + FRAME_HEADER_SIZE;
+            pos += FRAME_HEADER_SIZE + length;
+            if (!handleFrame(type, flags, streamId, payload, length)) {
+                input.clear();
+                return false;
+            }
+        }
+        input.erase(0, pos);
+        return true;
+    }
+
+    // 取走已经完整接收（请求方向结束）的请求：<流 ID, 请求>
+    std::vector<std::pair<uint32_t, std::shared_ptr<HttpRequest>>> takeRequests() {
+        return std::move(readyRequests);
+    }
+
+    // 提交一个流的响应。流式响应体需要调用方先物化；文件响应按发送窗口逐帧 pread。
+    // 普通响应体从 response 中移走，不再复制。流已经被对端重置时直接丢弃。
+    void submitResponse(uint32_t streamId, HttpResponse response) {
+        auto it = streams.find(streamId);
+        if (it == streams.end() || it->second.responding) {
+            return;
+        }
+        Stream& stream = it->second;
+
+        std::vector<HeaderField> fields;
+        fields.push_back({":status", std::to_string(response.getStatusCode())});
+        bool hasLength = false;
+        for (const auto& header : response.getHeaders()) {
+            std::string name = header.first;
+            for (auto& c : name) c = tolower(c);
+            // HTTP/2 禁止连接级头部
+            if (name == "connection" || name == "keep-alive" || name == "transfer-encoding" ||
+                name == "upgrade" || name == "proxy-connection") {
+                continue;
+            }
+            hasLength = hasLength || name == "content-length";
+            fields.push_back({name, header.second});
+        }
+        size_t bodySize = response.getFileBody() ? response.getFileLength() : response.getBody().size();
+        if (!hasLength) {
+            fields.push_back({"content-length", std::to_string(bodySize)});
+        }
+
+        std::string block;
+        encoder.encode(fields, block);
+        writeHeaders(streamId, block, bodySize == 0);
+        if (bodySize == 0) {
+            streams.erase(it);
+            return;
+        }
+
+        stream.responding = true;
+        if (response.getFileBody()) {
+            stream.file = response.getFileBody();
+            stream.fileOffset = response.getFileOffset();
+            stream.remaining = response.getFileLength();
+        } else {
+            stream.pending = response.takeBody();
+            stream.remaining = stream.pending.size();
+        }
+        pump();
+    }
+
+    // 在流量控制窗口允许的范围内为各个流轮流生成 DATA 帧。
+    // 输出缓冲区超过高水位时停止，等服务器把数据写出去后再次调用。
+    void pump() {
+        while (connectionWindow > 0 && output.size() < OUTPUT_HIGH_WATER) {
+            bool progress = false;
+            for (auto it = streams.begin(); it != streams.end() && connectionWindow > 0;) {
+                Stream& stream = it->second;
+                if (!stream.responding || stream.sendWindow <= 0) {
+                    ++it;
+                    continue;
+                }
+                size_t n = std::min<size_t>({stream.remaining, static_cast<size_t>(stream.sendWindow),
+                                             static_cast<size_t>(connectionWindow), peerMaxFrameSize});
+                bool last = n == stream.remaining;
+                if (!appendData(it->first, stream, n, last)) {
+                    LOG_ERROR("Failed to read file body for HTTP/2 stream %u: %s", it->first, strerror(errno));
+                    writeRstStream(it->first, INTERNAL_ERROR);
+                    it = streams.erase(it);
+                    continue;
+                }
+                stream.sendWindow -= n;
+                connectionWindow -= n;
+                stream.remaining -= n;
+                progress = true;
+                if (last && stream.rejected && !stream.remoteClosed) {
+                    writeRstStream(it->first, NO_ERROR); // 413 已发完，让对端停止发送请求体
+                }
+                it = last ? streams.erase(it) : std::next(it);
+            }
+            if (!progress) {
+                break;
+            }
+        }
+    }
+
+    // 把待发送的帧追加到 out
+    void takeOutput(std::string& out) {
+        if (out.empty()) {
+            out.swap(output);
+        } else {
+            out += output;
+            output.clear();
+        }
+    }
+
+    // 已经发送 GOAWAY，或对端发送 GOAWAY 且所有流都已完成时，连接可以关闭
+    bool shouldClose() const {
+        return goawaySent || (peerGoaway && streams.empty());
+    }
+
+private:
+    enum FrameType : uint8_t {
+        FRAME_DATA = 0x0, FRAME_HEADERS = 0x1, FRAME_PRIORITY = 0x2, FRAME_RST_STREAM = 0x3,
+        FRAME_SETTINGS = 0x4, FRAME_PUSH_PROMISE = 0x5, FRAME_PING = 0x6, FRAME_GOAWAY = 0x7,
+        FRAME_WINDOW_UPDATE = 0x8, FRAME_CONTINUATION = 0x9
+    };
+
+    enum Flag : uint8_t {
+        FLAG_END_STREAM = 0x1, FLAG_ACK = 0x1, FLAG_END_HEADERS = 0x4, FLAG_PADDED = 0x8, FLAG_PRIORITY = 0x20
+    };
+
+    enum Setting : uint16_t {
+        SETTINGS_HEADER_TABLE_SIZE = 0x1, SETTINGS_ENABLE_PUSH = 0x2, SETTINGS_MAX_CONCURRENT_STREAMS = 0x3,
+        SETTINGS_INITIAL_WINDOW_SIZE = 0x4, SETTINGS_MAX_FRAME_SIZE = 0x5
+    };
+
+    enum ErrorCode : uint32_t {
+        NO_ERROR = 0x0, PROTOCOL_ERROR = 0x1, INTERNAL_ERROR = 0x2, FLOW_CONTROL_ERROR = 0x3,
+        STREAM_CLOSED = 0x5, FRAME_SIZE_ERROR = 0x6, REFUSED_STREAM = 0x7, COMPRESSION_ERROR = 0x9,
+        ENHANCE_YOUR_CALM = 0xb
+    };
+
+    static constexpr size_t FRAME_HEADER_SIZE = 9;
+    static constexpr int64_t DEFAULT_WINDOW = 65535;
+    static constexpr int64_t MAX_WINDOW = 0x7FFFFFFF;
+    static constexpr size_t MAX_HEADER_BLOCK = 64 * 1024;
+    static constexpr size_t OUTPUT_HIGH_WATER = 256 * 1024;
+
+    struct Stream {
+        std::vector<HeaderField> headers;
+        std::string body;
+        bool remoteClosed = false; // 已收到 END_STREAM，请求已交给服务器
+        bool responding = false;   // 响应头已发送，正在发送响应体
+        bool rejected = false;     // 请求体超过上限，已回应 413，之后收到的数据直接丢弃
+        int64_t sendWindow = DEFAULT_WINDOW;
+        int64_t recvWindow = LOCAL_INITIAL_WINDOW; // 流级接收窗口
+        std::string pending;       // 普通响应体
+        std::shared_ptr<const OpenFile> file; // 文件响应体
+        off_t fileOffset = 0;
+        size_t remaining = 0;
+    };
+
+    bool handleFrame(uint8_t type, uint8_t flags, uint32_t streamId, const uint8_t* payload, uint32_t length) {
+        // 头部块必须连续：HEADERS 之后只能跟同一个流的 CONTINUATION
+        if (headerStream != 0 && (type != FRAME_CONTINUATION || streamId != headerStream)) {
+            return goAway(PROTOCOL_ERROR);
+        }
+
+        switch (type) {
+            case FRAME_DATA:
+                return handleData(flags, streamId, payload, length);
+            case FRAME_HEADERS:
+                return handleHeaders(flags, streamId, payload, length);
+            case FRAME_CONTINUATION:
+                if (headerStream == 0) {
+                    return goAway(PROTOCOL_ERROR);
+                }
+                headerBlock.append(reinterpret_cast<const char*>(payload), length);
+                if (headerBlock.size() > MAX_HEADER_BLOCK) {
+                    return goAway(ENHANCE_YOUR_CALM);
+                }
+                return (flags & FLAG_END_HEADERS) ? finishHeaderBlock() : true;
+            case FRAME_PRIORITY:
+                return length == 5 ? true : goAway(FRAME_SIZE_ERROR); // 不实现优先级
+            case FRAME_RST_STREAM:
+                if (length != 4 || streamId == 0) {
+                    return goAway(length != 4 ? FRAME_SIZE_ERROR : PROTOCOL_ERROR);
+                }
+                eraseStream(streamId);
+                return true;
+            case FRAME_SETTINGS:
+                return handleSettings(flags, streamId, payload, length);
+            case FRAME_PUSH_PROMISE:
+                return goAway(PROTOCOL_ERROR); // 客户端不能推送
+            case FRAME_PING:
+                if (length != 8 || streamId != 0) {
+                    return goAway(length != 8 ? FRAME_SIZE_ERROR : PROTOCOL_ERROR);
+                }
+                if (!(flags & FLAG_ACK)) {
+                    writeFrame(FRAME_PING, FLAG_ACK, 0, std::string(reinterpret_cast<const char*>(payload), 8));
+                }
+                return true;
+            case FRAME_GOAWAY:
+                peerGoaway = true;
+                return true;
+            case FRAME_WINDOW_UPDATE:
+                return handleWindowUpdate(streamId, payload, length);
+            default:
+                return true; // 未知帧类型必须忽略
+        }
+    }
+
+    bool handleData(uint8_t flags, uint32_t streamId, const uint8_t* payload, uint32_t length) {
+        if (streamId == 0) {
+            return goAway(PROTOCOL_ERROR);
+        }
+        // 整个帧（含填充）都计入流量控制。连接级额度在数据被消费（请求交给服务器或被丢弃）后才归还，
+        // 填充和发往已关闭流的数据当即视为已消费
+        connectionRecvWindow -= length;
+        if (connectionRecvWindow < 0) {
+            return goAway(FLOW_CONTROL_ERROR);
+        }
+        const uint8_t* data = payload;
+        size_t size = length;
+        if (!stripPadding(flags, data, size)) {
+            return goAway(PROTOCOL_ERROR);
+        }
+        releaseReceived(length - size);
+
+        auto it = streams.find(streamId);
+        if (it == streams.end() || it->second.remoteClosed) {
+            releaseReceived(size);
+            if (streamId > lastStreamId) {
+                return goAway(PROTOCOL_ERROR); // 空闲流上不能出现 DATA
+            }
+            writeRstStream(streamId, STREAM_CLOSED);
+            return true;
+        }
+        Stream& stream = it->second;
+        stream.recvWindow -= length;
+        if (stream.recvWindow < 0) {
+            releaseReceived(size);
+            writeRstStream(streamId, FLOW_CONTROL_ERROR);
+            eraseStream(streamId);
+            return true;
+        }
+        bool endStream = (flags & FLAG_END_STREAM) != 0;
+        stream.remoteClosed = endStream;
+        if (stream.rejected) {
+            releaseReceived(size);
+        } else if (stream.body.size() + size > HttpRequest::MAX_BODY_SIZE) {
+            releaseReceived(size);
+            rejectTooLarge(streamId, stream); // 响应可能已经发完，流随之删除，之后不能再访问 stream
+            return true;
+        } else {
+            stream.body.append(reinterpret_cast<const char*>(data), size);
+        }
+
+        if (endStream) {
+            if (!stream.rejected) {
+                emitRequest(streamId);
+            }
+        } else if (stream.recvWindow <= LOCAL_INITIAL_WINDOW / 2) {
+            // 流级窗口用掉一半再一次补满，不逐帧回复 WINDOW_UPDATE；缓存总量由连接级窗口约束
+            sendWindowUpdate(streamId, LOCAL_INITIAL_WINDOW - stream.recvWindow);
+            stream.recvWindow = LOCAL_INITIAL_WINDOW;
+        }
+        return true;
+    }
+
+    // 请求体已被消费的字节数归还给连接级接收窗口，攒够半个流窗口再发一次 WINDOW_UPDATE
+    void releaseReceived(size_t n) {
+        receivedConsumed += n;
+        if (receivedConsumed >= LOCAL_INITIAL_WINDOW / 2) {
+            sendWindowUpdate(0, receivedConsumed);
+            connectionRecvWindow += receivedConsumed;
+            receivedConsumed = 0;
+        }
+    }
+
+    // 删除流，缓存着的请求体随之丢弃，归还它占用的连接级额度
+    void eraseStream(uint32_t streamId) {
+        auto it = streams.find(streamId);
+        if (it != streams.end()) {
+            releaseReceived(it->second.body.size());
+            streams.erase(it);
+        }
+    }
+
+    // 请求体超过 HttpRequest::MAX_BODY_SIZE：直接回应 413，释放已缓存的请求体。
+    // 对端还没有结束请求时，响应发完后再用 RST_STREAM(NO_ERROR) 让它停止发送（见 pump）
+    void rejectTooLarge(uint32_t streamId, Stream& stream) {
+        LOG_WARNING("HTTP/2 stream %u request body exceeds %zu bytes", streamId, HttpRequest::MAX_BODY_SIZE);
+        releaseReceived(stream.body.size());
+        std::string().swap(stream.body);
+        stream.headers.clear();
+        stream.rejected = true;
+        submitResponse(streamId, HttpResponse::makeErrorResponse(413, "Payload Too Large"));
+    }
+
+    bool handleHeaders(uint8_t flags, uint32_t streamId, const uint8_t* payload, uint32_t length) {
+        if (streamId == 0) {
+            return goAway(PROTOCOL_ERROR);
+        }
+        const uint8_t* data = payload;
+        size_t size = length;
+        if (!stripPadding(flags, data, size)) {
+            return goAway(PROTOCOL_ERROR);
+        }
+        if (flags & FLAG_PRIORITY) {
+            if (size < 5) {
+                return goAway(FRAME_SIZE_ERROR);
+            }
+            data += 5;
+            size -= 5;
+        }
+        headerStream = streamId;
+        headerEndStream = (flags & FLAG_END_STREAM) != 0;
+        headerBlock.assign(reinterpret_cast<const char*>(data), size);
+        return (flags & FLAG_END_HEADERS) ? finishHeaderBlock() : true;
+    }
+
+    // 头部块收齐后解码。即使随后要拒绝这个流也必须先解码，否则 HPACK 动态表会与对端失去同步
+    bool finishHeaderBlock() {
+        uint32_t streamId = headerStream;
+        headerStream = 0;
+        std::vector<HeaderField> fields;
+        bool ok = decoder.decode(reinterpret_cast<const uint8_t*>(headerBlock.data()), headerBlock.size(), fields);
+        headerBlock.clear();
+        if (!ok) {
+            return goAway(COMPRESSION_ERROR);
+        }
+
+        auto it = streams.find(streamId);
+        if (it != streams.end()) {
+            // 已有流上的 HEADERS 是请求尾部（trailers），内容不需要，只关心是否结束
+            if (it->second.remoteClosed || !headerEndStream) {
+                writeRstStream(streamId, it->second.remoteClosed ? STREAM_CLOSED : PROTOCOL_ERROR);
+                eraseStream(streamId);
+                return true;
+            }
+            it->second.remoteClosed = true;
+            if (!it->second.rejected) {
+                emitRequest(streamId);
+            }
+            return true;
+        }
+
+        if (streamId % 2 == 0 || streamId <= lastStreamId) {
+            return goAway(PROTOCOL_ERROR);
+        }
+        lastStreamId = streamId;
+        if (peerGoaway || streams.size() >= MAX_CONCURRENT_STREAMS) {
+            writeRstStream(streamId, REFUSED_STREAM);
+            return true;
+        }
+        Stream& stream = streams[streamId];
+        stream.sendWindow = peerInitialWindow;
+        stream.headers = std::move(fields);
+        if (headerEndStream) {
+            stream.remoteClosed = true;
+            emitRequest(streamId);
+        } else if (declaredLength(stream.headers) > HttpRequest::MAX_BODY_SIZE) {
+            rejectTooLarge(streamId, stream); // 不必等请求体传完
+        }
+        return true;
+    }
+
+    // content-length 头部声明的请求体长度，没有或无法解析时返回 0
+    static unsigned long long declaredLength(const std::vector<HeaderField>& headers) {
+        for (const auto& field : headers) {
+            if (field.name == "content-length") {
+                return std::strtoull(field.value.c_str(), nullptr, 10);
+            }
+        }
+        return 0;
+    }
+
+    bool handleSettings(uint8_t flags, uint32_t streamId, const uint8_t* payload, uint32_t length) {
+        if (streamId != 0) {
+            return goAway(PROTOCOL_ERROR);
+        }
+        if (flags & FLAG_ACK) {
+            return length == 0 ? true : goAway(FRAME_SIZE_ERROR);
+        }
+        if (length % 6 != 0) {
+            return goAway(FRAME_SIZE_ERROR);
+        }
+        ErrorCode error = applySettings(reinterpret_cast<const char*>(payload), length);
+        if (error != NO_ERROR) {
+            return goAway(error);
+        }
+        writeFrame(FRAME_SETTINGS, FLAG_ACK, 0, std::string());
+        pump(); // 初始窗口可能变大了
+        return true;
+    }
+
+    ErrorCode applySettings(const char* data, size_t length) {
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+        for (size_t i = 0; i + 6 <= length; i += 6) {
+            uint16_t id = (p[i] << 8) | p[i + 1];
+            uint32_t value = (p[i + 2] << 24) | (p[i + 3] << 16) | (p[i + 4] << 8) | p[i + 5];
+            switch (id) {
+                case SETTINGS_HEADER_TABLE_SIZE:
+                    encoder.setMaxTableSize(value);
+                    break;
+                case SETTINGS_ENABLE_PUSH:
+                    if (value > 1) return PROTOCOL_ERROR;
+                    break;
+                case SETTINGS_INITIAL_WINDOW_SIZE: {
+                    if (value > MAX_WINDOW) return FLOW_CONTROL_ERROR;
+                    // 初始窗口变化按差值调整所有已打开流的发送窗口
+                    int64_t delta = static_cast<int64_t>(value) - peerInitialWindow;
+                    for (auto& entry : streams) {
+                        entry.second.sendWindow += delta;
+                        if (entry.second.sendWindow > MAX_WINDOW) return FLOW_CONTROL_ERROR;
+                    }
+                    peerInitialWindow = value;
+                    break;
+                }
+                case SETTINGS_MAX_FRAME_SIZE:
+                    if (value < 16384 || value > 16777215) return PROTOCOL_ERROR;
+                    peerMaxFrameSize = value;
+                    break;
+                default:
+                    break; // 未知参数忽略
+            }
+        }
+        return NO_ERROR;
+    }
+
+    bool handleWindowUpdate(uint32_t streamId, const uint8_t* payload, uint32_t length) {
+        if (length != 4) {
+            return goAway(FRAME_SIZE_ERROR);
+        }
+        uint32_t increment = ((payload[0] << 24) | (payload[1] << 16) | (payload[2] << 8) | payload[3]) & 0x7FFFFFFF;
+        if (streamId == 0) {
+            if (increment == 0) {
+                return goAway(PROTOCOL_ERROR);
+            }
+            connectionWindow += increment;
+            if (connectionWindow > MAX_WINDOW) {
+                return goAway(FLOW_CONTROL_ERROR);
+            }
+        } else {
+            auto it = streams.find(streamId);
+            if (it == streams.end()) {
+                return true; // 已关闭的流上迟到的 WINDOW_UPDATE
+            }
+            it->second.sendWindow += increment;
+            if (increment == 0 || it->second.sendWindow > MAX_WINDOW) {
+                writeRstStream(streamId, increment == 0 ? PROTOCOL_ERROR : FLOW_CONTROL_ERROR);
+                eraseStream(streamId);
+                return true;
+            }
+        }
+        pump();
+        return true;
+    }
+
+    // 把伪头部和普通头部还原成 HTTP/1.1 请求文本，复用 HttpRequest 的解析逻辑，
+    // 这样 Router 和处理函数不需要区分请求来自哪个协议版本
+    void emitRequest(uint32_t streamId) {
+        Stream& stream = streams[streamId];
+        std::string method, path, authority, cookie, headerText;
+        bool hasHost = false;
+        bool valid = true;
+        for (const auto& field : stream.headers) {
+            if (field.name.find_first_of("\r\n") != std::string::npos ||
+                field.value.find_first_of("\r\n") != std::string::npos) {
+                valid = false;
+                break;
+            }
+            if (field.name == ":method") method = field.value;
+            else if (field.name == ":path") path = field.value;
+            else if (field.name == ":authority") authority = field.value;
+            else if (field.name[0] == ':') continue; // :scheme
+            else if (field.name == "cookie") cookie += (cookie.empty() ? "" : "; ") + field.value; // 允许拆分成多个字段
+            else {
+                hasHost = hasHost || field.name == "host";
+                headerText += field.name + ": " + field.value + "\r\n";
+            }
+        }
+        if (!valid || method.empty() || path.empty()) {
+            writeRstStream(streamId, PROTOCOL_ERROR);
+            eraseStream(streamId);
+            return;
+        }
+        if (!hasHost && !authority.empty()) {
+            headerText += "host: " + authority + "\r\n";
+        }
+        if (!cookie.empty()) {
+            headerText += "cookie: " + cookie + "\r\n";
+        }
+
+        std::string text = method + " " + path + " HTTP/2.0\r\n" + headerText + "\r\n" + stream.body;
+        stream.headers.clear();
+        releaseReceived(stream.body.size()); // 请求体已经移交，归还连接级接收窗口
+        std::string().swap(stream.body);
+        auto request = std::make_shared<HttpRequest>();
+        if (!request->parse(text)) {
+            writeRstStream(streamId, PROTOCOL_ERROR);
+            streams.erase(streamId);
+            return;
+        }
+        readyRequests.emplace_back(streamId, std::move(request));
+    }
+
+    static bool stripPadding(uint8_t flags, const uint8_t*& data, size_t& size) {
+        if (!(flags & FLAG_PADDED)) {
+            return true;
+        }
+        if (size < 1 || data[0] >= size) {
+            return false;
+        }
+        size -= 1 + data[0];
+        data += 1;
+        return true;
+    }
+
+    // 追加一个 DATA 帧；文件响应体在这里才从页缓存读取，每次最多一个帧的大小
+    bool appendData(uint32_t streamId, Stream& stream, size_t n, bool last) {
+        appendFrameHeader(n, FRAME_DATA, last ? FLAG_END_STREAM : 0, streamId);
+        if (!stream.file) {
+            output.append(stream.pending, stream.pending.size() - stream.remaining, n);
+            return true;
+        }
+        size_t start = output.size();
+        output.resize(start + n);
+        size_t done = 0;
+        while (done < n) {
+            ssize_t r = pread(stream.file->fd, &output[start + done], n - done, stream.fileOffset);
+            if (r < 0 && errno == EINTR) {
+                continue;
+            }
+            if (r <= 0) {
+                output.resize(start - FRAME_HEADER_SIZE);
+                return false;
+            }
+            done += r;
+            stream.fileOffset += r;
+        }
+        return true;
+    }
+
+    void writeHeaders(uint32_t streamId, const std::string& block, bool endStream) {
+        size_t pos = 0;
+        uint8_t type = FRAME_HEADERS;
+        do {
+            size_t n = std::min(block.size() - pos, peerMaxFrameSize);
+            uint8_t flags = (type == FRAME_HEADERS && endStream) ? FLAG_END_STREAM : 0;
+            if (pos + n == block.size()) {
+                flags |= FLAG_END_HEADERS;
+            }
+            writeFrame(type, flags, streamId, block.substr(pos, n));
+            pos += n;
+            type = FRAME_CONTINUATION;
+        } while (pos < block.size());
+    }
+
+    void writeRstStream(uint32_t streamId, ErrorCode code) {
+        std::string payload;
+        appendUint32(payload, code);
+        writeFrame(FRAME_RST_STREAM, 0, streamId, payload);
+    }
+
+    void sendWindowUpdate(uint32_t streamId, uint32_t increment) {
+        std::string payload;
+        appendUint32(payload, increment);
+        writeFrame(FRAME_WINDOW_UPDATE, 0, streamId, payload);
+    }
+
+    // 发送 GOAWAY 后连接进入关闭流程，总是返回 false 以便直接作为 handleFrame 的结果
+    bool goAway(ErrorCode code) {
+        if (!goawaySent) {
+            std::string payload;
+            appendUint32(payload, lastStreamId);
+            appendUint32(payload, code);
+            writeFrame(FRAME_GOAWAY, 0, 0, payload);
+            goawaySent = true;
+            LOG_WARNING("HTTP/2 connection error %u, sending GOAWAY", code);
+        }
+        return false;
+    }
+
+    void writeFrame(uint8_t type, uint8_t flags, uint32_t streamId, const std::string& payload) {
+        appendFrameHeader(payload.size(), type, flags, streamId);
+        output += payload;
+    }
+
+    void appendFrameHeader(size_t length, uint8_t type, uint8_t flags, uint32_t streamId) {
+        output += static_cast<char>((length >> 16) & 0xFF);
+        output += static_cast<char>((length >> 8) & 0xFF);
+        output += static_cast<char>(length & 0xFF);
+        output += static_cast<char>(type);
+        output += static_cast<char>(flags);
+        appendUint32(output, streamId & 0x7FFFFFFF);
+    }
+
+    static void appendUint32(std::string& out, uint32_t value) {
+        out += static_cast<char>((value >> 24) & 0xFF);
+        out += static_cast<char>((value >> 16) & 0xFF);
+        out += static_cast<char>((value >> 8) & 0xFF);
+        out += static_cast<char>(value & 0xFF);
+    }
+
+    static void appendSetting(std::string& out, uint16_t id, uint32_t value) {
+        out += static_cast<char>((id >> 8) & 0xFF);
+        out += static_cast<char>(id & 0xFF);
+        appendUint32(out, value);
+    }
+
+    // HTTP2-Settings 使用不带填充的 base64url 编码
+    static bool base64UrlDecode(const std::string& in, std::string& out) {
+        unsigned v = 0;
+        int bits = 0;
+        for (char c : in) {
+            int d;
+            if (c >= 'A' && c <= 'Z') d = c - 'A';
+            else if (c >= 'a' && c <= 'z') d = c - 'a' + 26;
+            else if (c >= '0' && c <= '9') d = c - '0' + 52;
+            else if (c == '-') d = 62;
+            else if (c == '_') d = 63;
+            else if (c == '=') break;
+            else return false;
+            v = (v << 6) | d;
+            bits += 6;
+            if (bits >= 8) {
+                bits -= 8;
+                out += static_cast<char>((v >> bits) & 0xFF);
+            }
+        }
+        return true;
+    }
+
+    std::string input;  // 尚未凑成完整帧的输入
+    std::string output; // 待写到套接字的帧
+    bool prefaceReceived = false;
+    bool goawaySent = false;
+    bool peerGoaway = false;
+
+    HpackDecoder decoder;
+    HpackEncoder encoder;
+    uint32_t headerStream = 0; // 正在接收头部块（等待 CONTINUATION）的流
+    bool headerEndStream = false;
+    std::string headerBlock;
+
+    std::map<uint32_t, Stream> streams; // 按流 ID 有序，pump 时轮流发送
+    uint32_t lastStreamId = 0;
+    std::vector<std::pair<uint32_t, std::shared_ptr<HttpRequest>>> readyRequests;
+
+    int64_t connectionWindow = DEFAULT_WINDOW; // 连接级发送窗口
+    int64_t connectionRecvWindow = LOCAL_CONNECTION_WINDOW; // 连接级接收窗口
+    size_t receivedConsumed = 0; // 已消费、尚未通过 WINDOW_UPDATE 归还的接收额度
+    int64_t peerInitialWindow = DEFAULT_WINDOW;
+    size_t peerMaxFrameSize = 16384;
+};
@@ -2,9 +2,14 @@
 #include <string>
 #include <unordered_map>
 #include <sstream>
+#include <string_view>
+#include "UrlEncoded.h"
 
 class HttpRequest {
 public:
+    // 请求体大小上限，HTTP/1.1 按 Content-Length、HTTP/2 按实际收到的 DATA 检查
+    static constexpr size_t MAX_BODY_SIZE = 64 * 1024 * 1024;
+
     enum Method {
         GET, POST, HEAD, PUT, DELETE, TRACE, OPTIONS, CONNECT, PATCH, UNKNOWN
     };
@@ -51,22 +56,29 @@ public:
         return result;
     }
 
-    std::unordered_map<std::string, std::string> parseFormBody() const {
-        std::unordered_map<std::string, std::string> params;
-        if (method != POST) return params;
-
-        std::istringstream stream(body);
-        std::string pair;
+    // urlencoded 请求体参数，第一次调用时解析并缓存在请求上，值已经完成百分号解码。
+    // 返回的 string_view 指向请求自身的数据，只在请求对象存活期间有效。
+    const UrlEncodedParams& parseFormBody() const {
+        if (!formParams.parsed) {
+            formParams.parsed = true;
+            if (method == POST) {
+                formParams.params.parse(body);
+            }
+        }
+        return formParams.params;
+    }
 
-        while (std::getline(stream, pair, '&')) {
-            std::size_t pos = pair.find('=');
-            if (pos == std::string::npos) continue;
-            std::string key = pair.substr(0, pos);
-            std::string value = pair.substr(pos + 1);
-            params[key] = value;
+    // 查询字符串参数，同样惰性解析并缓存
+    const UrlEncodedParams& getQueryParams() const {
+        if (!queryParams.parsed) {
+            queryParams.parsed = true;
+            queryParams.params.parse(query);
         }
+        return queryParams.params;
+    }
 
-        return params;
+    std::string_view getQueryParam(std::string_view name) const {
+        return getQueryParams().get(name);
     }
 
     std::string getMethodString() const {
@@ -77,18 +89,57 @@ public:
         }
     }
 
+    // 不含查询字符串的路径，用于路由匹配
     const std::string& getPath() const {
         return path;
     }
 
+    // 请求行中的原始目标（路径加查询字符串）
+    const std::string& getTarget() const {
+        return target;
+    }
+
+    const std::string& getQueryString() const {
+        return query;
+    }
+
+    // 头部名称不区分大小写（HTTP/2 要求小写），统一按小写存储和查找
     std::string getHeader(const std::string& key) const {
-        auto it = headers.find(key);
+        auto it = headers.find(toLower(key));
         if (it != headers.end()) {
             return it->second;
         }
         return "";
     }
 
+    // 从 Cookie 请求头中取出指定名称的值
+    std::string getCookie(const std::string& name) const {
+        std::string cookies = getHeader("Cookie");
+        size_t pos = 0;
+        while (pos < cookies.size()) {
+            size_t end = cookies.find(';', pos);
+            if (end == std::string::npos) end = cookies.size();
+            size_t start = cookies.find_first_not_of(' ', pos);
+            size_t eq = cookies.find('=', start);
+            if (start < end && eq != std::string::npos && eq < end && cookies.compare(start, eq - start, name) == 0) {
+                std::string value = cookies.substr(eq + 1, end - eq - 1);
+                if (!value.empty() && value.back() == '\r') value.pop_back();
+                return value;
+            }
+            pos = end + 1;
+        }
+        return "";
+    }
+
+    // 会话令牌校验通过后由路由层设置的当前用户名，未登录时为空
+    const std::string& getSessionUser() const {
+        return sessionUser;
+    }
+
+    void setSessionUser(const std::string& user) {
+        sessionUser = user;
+    }
+
     std::string getFormField(const std::string& fieldName) const {
         auto it = formFields.find(fieldName);
         if (it != formFields.end()) {
@@ -122,21 +173,33 @@ private:
         if (methodStr == "GET") method = GET;
         else if (methodStr == "POST") method = POST;
         else method = UNKNOWN;
-        iss >> path;
+        iss >> target;
+        size_t question = target.find('?');
+        path = target.substr(0, question);
+        query = question == std::string::npos ? std::string() : target.substr(question + 1);
         iss >> version;
         state = HEADERS;
         return true;
     }
 
     bool parseHeader(const std::string& line) {
-        size_t pos = line.find(": ");
+        size_t pos = line.find(':');
         if (pos == std::string::npos) return false;
         std::string key = line.substr(0, pos);
-        std::string value = line.substr(pos + 2);
-        headers[key] = value;
+        size_t valueStart = line.find_first_not_of(" \t", pos + 1); // 冒号后的空白可有可无
+        std::string value = valueStart == std::string::npos ? "" : line.substr(valueStart);
+        if (!value.empty() && value.back() == '\r') {
+            value.pop_back(); // getline 按 '\n' 切分，去掉行尾的 '\r'
+        }
+        headers[toLower(key)] = value;
         return true;
     }
 
+    static std::string toLower(std::string s) {
+        for (auto& c : s) c = tolower(static_cast<unsigned char>(c));
+        return s;
+    }
+
     // 解析多部分表单数据，这通常用于文件上传请求
     // @param boundary 分界符，用于识别请求主体中的不同部分
     void parseMultipartFormData(const std::string& boundary) {
@@ -206,12 +269,31 @@ private:
         return "";
     }
 
+    // 解析结果中的 string_view 指向所属请求的成员；复制或移动请求时源对象的缓存不能带过去，需要重新解析
+    struct LazyParams {
+        bool parsed = false;
+        UrlEncodedParams params;
+
+        LazyParams() = default;
+        LazyParams(const LazyParams&) {}
+        LazyParams& operator=(const LazyParams&) {
+            parsed = false;
+            params.clear();
+            return *this;
+        }
+    };
+
     Method method;
+    std::string target;
     std::string path;
+    std::string query;
     std::string version;
     std::unordered_map<std::string, std::string> headers;
     ParseState state;
     std::string body;
+    std::string sessionUser;
+    mutable LazyParams formParams;
+    mutable LazyParams queryParams;
 
     // 新增的成员变量
     std::unordered_map<std::string, std::string> fileNames;
@@ -1,16 +1,28 @@
 #pragma once
+#include <cstdint>
 #include <string>
 #include <unordered_map>
 #include <sstream>
+#include <functional>
+#include <memory>
+#include "Executor.h"
+#include "FileCache.h"
 
 class HttpResponse {
 public:
+    // 流式响应体的生产者：每次调用向 chunk 写入下一段数据，返回 false 表示已经结束
+    using BodyProducer = std::function<bool(std::string& chunk)>;
+
     HttpResponse(int code = 200) : statusCode(code) {}
 
     void setStatusCode(int code) {
         statusCode = code;
     }
 
+    int getStatusCode() const {
+        return statusCode;
+    }
+
     void setHeader(const std::string& name, const std::string& value) {
         headers[name] = value;
     }
@@ -19,16 +31,142 @@ public:
         body = b;
     }
 
+    const std::unordered_map<std::string, std::string>& getHeaders() const {
+        return headers;
+    }
+
+    const std::string& getBody() const {
+        return body;
+    }
+
+    // 移走响应体，之后 getBody() 为空
+    std::string takeBody() {
+        return std::move(body);
+    }
+
+    // 设置流式响应体，服务器以 Transfer-Encoding: chunked 边生产边发送。
+    // 只有在套接字缓冲区有空间时才会拉取下一段，exec 指定生产者在哪类执行器上运行
+    // （例如从数据库游标读取时应使用 BLOCKING）。
+    void setStreamingBody(BodyProducer producer, ExecClass exec = ExecClass::WORKER) {
+        bodyProducer = std::make_shared<BodyProducer>(std::move(producer));
+        producerExec = exec;
+        body.clear();
+    }
+
+    // 以文件内容作为响应体，服务器通过 sendfile() 直接从页缓存发送，不经过用户态缓冲区
+    void setFileBody(std::shared_ptr<const OpenFile> file, off_t offset, size_t length) {
+        fileBody = std::move(file);
+        fileOffset = offset;
+        fileLength = length;
+        body.clear();
+    }
+
+    const std::shared_ptr<const OpenFile>& getFileBody() const {
+        return fileBody;
+    }
+
+    off_t getFileOffset() const {
+        return fileOffset;
+    }
+
+    size_t getFileLength() const {
+        return fileLength;
+    }
+
+    // 根据文件扩展名推断 Content-Type
+    static std::string getMimeType(const std::string& path) {
+        static const std::unordered_map<std::string, std::string> types = {
+            {"jpg", "image/jpeg"}, {"jpeg", "image/jpeg"}, {"png", "image/png"},
+            {"gif", "image/gif"}, {"webp", "image/webp"}, {"bmp", "image/bmp"},
+            {"svg", "image/svg+xml"}, {"ico", "image/x-icon"},
+            {"html", "text/html"}, {"css", "text/css"}, {"js", "application/javascript"},
+            {"json", "application/json"}, {"txt", "text/plain"}
+        };
+        size_t dot = path.rfind('.');
+        if (dot != std::string::npos) {
+            std::string ext = path.substr(dot + 1);
+            for (auto& c : ext) c = tolower(c);
+            auto it = types.find(ext);
+            if (it != types.end()) {
+                return it->second;
+            }
+        }
+        return "application/octet-stream";
+    }
+
+    bool isStreaming() const {
+        return bodyProducer != nullptr;
+    }
+
+    const std::shared_ptr<BodyProducer>& getBodyProducer() const {
+        return bodyProducer;
+    }
+
+    ExecClass getProducerExec() const {
+        return producerExec;
+    }
+
+    // 把流式响应体一次性读完，转换为普通响应（用于需要完整响应的场景，例如写入缓存）。
+    // 会在调用线程上运行生产者，调用方需要保证线程类别与 getProducerExec() 相符。
+    // 读入的数据超过 limit 时停止并返回 false：响应仍是流式的，已读出的部分作为第一块发送
+    bool materialize(size_t limit = SIZE_MAX) {
+        if (!bodyProducer) {
+            return true;
+        }
+        auto producer = bodyProducer;
+        std::string all, chunk;
+        bool more = true;
+        while (more) {
+            chunk.clear();
+            more = (*producer)(chunk);
+            all += chunk;
+            if (more && all.size() > limit) {
+                auto prefix = std::make_shared<std::string>(std::move(all));
+                bodyProducer = std::make_shared<BodyProducer>([prefix, producer](std::string& out) {
+                    if (!prefix->empty()) {
+                        out.swap(*prefix);
+                        return true;
+                    }
+                    return (*producer)(out);
+                });
+                return false;
+            }
+        }
+        bodyProducer = nullptr;
+        body = std::move(all);
+        return true;
+    }
+
+    // 流式响应只序列化状态行和头部，响应体由服务器按块发送
     std::string toString() const {
         std::ostringstream oss;
         oss << "HTTP/1.1 " << statusCode << " " << getStatusMessage() << "\r\n";
         for (const auto& header : headers) {
-            oss << header.first << "; " << header.second << "\r\n";
+            oss << header.first << ": " << header.second << "\r\n";
+        }
+        if (isStreaming()) {
+            oss << "Transfer-Encoding: chunked\r\n";
+        } else if (fileBody) {
+            oss << "Content-Length: " << fileLength << "\r\n";
+        } else if (headers.find("Content-Length") == headers.end()) {
+            oss << "Content-Length: " << body.size() << "\r\n";
+        }
+        oss << "\r\n";
+        if (!isStreaming()) {
+            oss << body;
         }
-        oss << "\r\n" << body;
         return oss.str();    
     }
 
+    // 按 chunked 编码格式追加一个数据块，空数据表示结束块
+    static void appendChunk(std::string& out, const std::string& data) {
+        char size[20];
+        snprintf(size, sizeof(size), "%zx\r\n", data.size());
+        out += size;
+        out += data;
+        out += "\r\n";
+    }
+
     static HttpResponse makeErrorResponse(int code, const std::string& message) {
         HttpResponse response(code);
         response.setBody(message);
@@ -47,6 +185,7 @@ private:
             case 200: return "OK"; // 请求成功，一切正常。
             case 201: return "Created"; // 请求成功并且创建了新资源。
             case 204: return "No Content"; // 请求已成功处理，但没有内容返回。
+            case 206: return "Partial Content"; // 成功返回了 Range 请求的部分内容。
             case 301: return "Moved Permanently"; // 资源已被永久移动到新的URL。
             case 302: return "Found"; // 资源临时重定向。
             case 304: return "Not Modified"; // 资源未被修改，使用缓存即可。
@@ -56,6 +195,9 @@ private:
             case 403: return "Forbidden"; // 禁止访问，即使有身份验证也可能拒绝访问。
             case 404: return "Not Found"; // 找不到所请求的资源。
             case 405: return "Method Not Allowed"; // 不允许使用请求的方法（如GET、POST）访问资源。
+            case 413: return "Payload Too Large"; // 请求体超过了服务器允许的大小。
+            case 416: return "Range Not Satisfiable"; // Range 请求的范围超出了资源大小。
+            case 429: return "Too Many Requests"; // 客户端超过了请求速率或连接数限制。
 
             case 500: return "Internal Server Error"; // 服务器遇到了一个未曾预期的情况，导致无法完成请求。
             case 503: return "Service Unavailable"; // 服务器暂时无法处理请求，通常由于过载或维护。
@@ -66,4 +208,9 @@ private:
     int statusCode; // 状态响应码
     std::unordered_map<std::string, std::string> headers;
     std::string body;
+    std::shared_ptr<BodyProducer> bodyProducer; // 非空表示流式响应
+    ExecClass producerExec = ExecClass::WORKER;
+    std::shared_ptr<const OpenFile> fileBody; // 非空表示通过 sendfile 发送的文件响应
+    off_t fileOffset = 0;
+    size_t fileLength = 0;
 };
\ No newline at end of file
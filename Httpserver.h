@@ -2,18 +2,38 @@
 #pragma once
 #include <sys/socket.h>
 #include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/sendfile.h>
 #include <fcntl.h>
 #include <netinet/in.h>
+#include <arpa/inet.h>
 #include <unistd.h>
+#include <csignal>
 #include <cstring>
+#include <strings.h>
 #include "Logger.h"
 #include "ThreadPool.h"
+#include "Executor.h"
 #include "Router.h"
+#include "Task.h"
+#include "ResponseCache.h"
+#include "Http2.h"
+#include "Tls.h"
+#include "Listener.h"
+#include "Config.h"
+#include "ClientLimiter.h"
+#include "Compression.h"
+#include "Capture.h"
+#include <pthread.h>
 #include "HttpRequest.h"
 #include "HttpResponse.h"
 #include "Database.h" 
 #include <fstream>
+#include <map>
 #include <sstream>
+#include <vector>
+#include <atomic>
 
 // Connection 结构体现在需要包含请求数据的缓冲区和状态信息
 struct Connection {
@@ -22,41 +42,202 @@ struct Connection {
     size_t sentBytes = 0; // 记录已发送的字节数
     bool requestComplete = false; // 标记请求是否已完全接收
     bool responseReady = false; // 标记响应是否准备好发送
+    // 流式响应状态：发送缓冲区清空后才向生产者拉取下一块，以此实现背压
+    std::shared_ptr<HttpResponse::BodyProducer> bodyProducer;
+    ExecClass producerExec = ExecClass::WORKER;
+    bool producing = false; // 生产者正在线程池中生成下一块
+    bool producerDone = true; // 结束块是否已经放入发送缓冲区
+    int producerRejects = 0; // 执行器连续拒绝拉取下一块的次数
+    // 文件响应：响应头发送完之后用 sendfile 发送文件区间
+    std::shared_ptr<const OpenFile> file;
+    off_t fileOffset = 0;
+    size_t fileRemaining = 0;
+    uint32_t interest = 0; // 当前注册在 epoll 中的事件，相同时跳过 epoll_ctl
+    // HTTP/2 连接的协议状态；非空时 responseData 只是帧的发送缓冲区，连接在响应之间保持打开
+    std::unique_ptr<Http2Session> h2;
+    uint64_t id = 0; // 连接序号，异步完成的流据此识别 fd 是否已被新连接复用
+    std::unique_ptr<TlsStream> tls; // 开启进程内 TLS 时非空，所有读写都经过它
+    std::string peer; // 对端 IP；AF_UNIX 连接为 "unix"
+    bool trustedPeer = false; // 可信反向代理的连接，限流时信任它转发的客户端地址
+    std::string quotaClient; // 占用了哪个客户端的并发连接名额，关闭时归还
 };
 
-class HttpServer {
+// 每类系统调用的累计次数，用于衡量每个请求平均消耗多少次系统调用
+struct SyscallCounters {
+    std::atomic<uint64_t> accepts{0};
+    std::atomic<uint64_t> reads{0};
+    std::atomic<uint64_t> writes{0};
+    std::atomic<uint64_t> epollCtls{0};
+    std::atomic<uint64_t> epollWaits{0};
+    std::atomic<uint64_t> requests{0};
+
+    static void add(std::atomic<uint64_t>& counter) {
+        counter.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    std::string toString() const {
+        uint64_t a = accepts.load(), r = reads.load(), w = writes.load(), c = epollCtls.load(),
+                 e = epollWaits.load(), n = requests.load();
+        std::ostringstream oss;
+        oss << "requests " << n << "\n"
+            << "accept " << a << "\n"
+            << "read " << r << "\n"
+            << "write " << w << "\n"
+            << "epoll_ctl " << c << "\n"
+            << "epoll_wait " << e << "\n";
+        if (n > 0) {
+            oss << "syscalls_per_request " << static_cast<double>(a + r + w + c + e) / n << "\n";
+        }
+        return oss.str();
+    }
+};
+
+// HttpServer 同时是协程的 ResumeExecutor：阻塞调用完成后，协程通过 eventfd 被投递回 I/O 线程恢复
+class HttpServer : public ResumeExecutor {
 public:
-    HttpServer(int port, int max_events, Database& db) : server_fd(-1), epollfd(-1), port(port), max_events(max_events), db(db) {}
+    // port 大于 0 时监听该 TCP 端口，其他端点通过 addListener 添加
+    HttpServer(int port, int max_events, Database& db, const ExecutorConfig& execConfig = ExecutorConfig())
+        : epollfd(-1), wakeup_fd(-1), timer_fd(-1), max_events(std::max(1, max_events)), db(db), executors(execConfig) {
+        if (port > 0) {
+            endpoints.push_back(std::to_string(port));
+        }
+        setTrustedProxies({"127.0.0.0/8", "::1"});
+    }
+
+    // 添加监听端点（TCP 或 "unix:" 开头的 AF_UNIX 路径，写法见 Listener.h），必须在 start() 之前调用
+    void addListener(const std::string& endpoint) {
+        endpoints.push_back(endpoint);
+    }
+
+    void setBacklog(int value) {
+        backlog = value;
+    }
+
+    // 每次 read 使用的缓冲区大小，大请求（上传）可以调大以减少 read 次数
+    void setReadBufferSize(size_t size) {
+        readBuffer.resize(size);
+    }
+
+    // 低延迟的忙轮询模式：事件循环以零超时反复 epoll_wait，省去每次唤醒时的调度延迟，
+    // 连续空闲超过 idle 后退回阻塞等待，有事件到来再恢复轮询。
+    // socketUsecs 大于 0 时对客户端套接字设置 SO_BUSY_POLL/SO_PREFER_BUSY_POLL，让内核在读时直接轮询网卡队列。
+    void enableBusyPoll(int socketUsecs, std::chrono::milliseconds idle) {
+        busyPoll = true;
+        busyPollSocketUsecs = socketUsecs;
+        busyPollIdle = idle;
+    }
+
+    // 按客户端限制请求速率和并发连接数，超限的请求在进入 Router 之前直接返回 429
+    void setClientLimits(const ClientLimiter::Limits& limits) {
+        limiter.configure(limits);
+    }
+
+    // 可信反向代理的地址段，替换默认的本机地址；AF_UNIX 端点总是可信。有无效的地址段时返回 false
+    bool setTrustedProxies(const std::vector<std::string>& cidrs) {
+        TrustedProxies proxies;
+        for (const auto& cidr : cidrs) {
+            if (!proxies.add(cidr)) {
+                LOG_ERROR("Invalid trusted proxy address: %s", cidr.c_str());
+                return false;
+            }
+        }
+        trustedProxies = std::move(proxies);
+        return true;
+    }
+
+    // 响应压缩策略，默认对 1KB 以上的文本类响应做 gzip
+    void setCompression(const Compression::Policy& policy) {
+        compression = policy;
+    }
+
+    // 抓包模式：把抽样的原始请求写入文件，用 replay 工具回放，必须在 start() 之前调用
+    bool enableCapture(const std::string& path, size_t sampleEvery, size_t maxBytes) {
+        auto file = std::make_unique<TrafficCapture>();
+        if (!file->open(path, sampleEvery, maxBytes)) {
+            return false;
+        }
+        capture = std::move(file);
+        LOG_INFO("Capturing 1 of every %zu requests to %s", sampleEvery, path.c_str());
+        return true;
+    }
+
+    // 按绑核方案固定线程池线程；I/O 线程在 start() 中绑定
+    void setThreadPlacement(const ThreadPlacement& placement) {
+        reactorCpu = placement.reactorCpu;
+        executors.setAffinity(placement.workerCpus, placement.blockingCpus);
+    }
 
- // 启动服务器方法，设置套接字、epoll、启动线程池并进入循环等待处理客户端连接
+    // 把任务投递到 I/O 线程执行，可以从任意线程调用
+    void post(std::function<void()> fn) override {
+        {
+            std::lock_guard<std::mutex> lock(postedMutex);
+            postedTasks.push_back(std::move(fn));
+        }
+        uint64_t one = 1;
+        ssize_t n = write(wakeup_fd, &one, sizeof(one)); // 唤醒 epoll_wait
+        (void)n;
+    }
+
+ // 启动服务器方法，设置套接字、epoll 并进入循环等待处理客户端连接
     void start() {
-        setupServerSocket(); // 创建并配置服务器套接字
+        if (!setupListeners()) { // 创建并绑定所有监听端点
+            return;
+        }
         setupEpoll(); // 创建并配置epoll实例
-        ThreadPool pool(16); // 创建一个拥有16个工作线程的线程池以应对高并发场景
+        ResumeExecutor::current() = this; // 协程在本线程上启动，也在本线程上恢复
+        if (reactorCpu >= 0) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(reactorCpu, &set);
+            pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        }
         
         // 初始化epoll_event数组，用于存放epoll_wait返回的就绪事件
-        struct epoll_event events[max_events];
+        std::vector<struct epoll_event> events(max_events);
+        // 每次取回的事件数按负载自适应：批次被填满说明就绪事件堆积，加倍以摊薄 epoll_wait 的开销；
+        // 连续只用到一小部分时减半。未取回的事件仍然留在就绪队列里，不会丢失。
+        int batch = std::min(max_events, MIN_EPOLL_BATCH);
+        int timeout = busyPoll ? 0 : -1;
+        auto lastActive = std::chrono::steady_clock::now();
 
         // 主循环，不断等待新的连接请求或已连接套接字上的读写事件
+        // 读写都是非阻塞的，直接在 I/O 线程上完成；只有路由处理函数按执行类别派发到线程池
         while (true) {
-            int nfds = epoll_wait(epollfd, events, max_events, -1); // 等待epoll事件发生
+            int nfds = epoll_wait(epollfd, events.data(), batch, timeout); // 等待epoll事件发生
+            SyscallCounters::add(syscalls.epollWaits);
+            if (busyPoll) {
+                if (nfds > 0) {
+                    lastActive = std::chrono::steady_clock::now();
+                    timeout = 0;
+                } else if (timeout == 0 && std::chrono::steady_clock::now() - lastActive > busyPollIdle) {
+                    timeout = -1; // 空闲太久，停止空转
+                }
+            }
+            if (nfds == batch) {
+                batch = std::min(batch * 2, max_events);
+            } else if (nfds < batch / 4 && batch > MIN_EPOLL_BATCH) {
+                batch /= 2;
+            }
             
             // 遍历所有就绪事件
             for (int n = 0; n < nfds; ++n) {
-                if (events[n].data.fd == server_fd) { // 如果是服务器套接字就绪
-                    acceptConnection(); // 接受新连接
+                if (Listener* listener = findListener(events[n].data.fd)) { // 如果是监听套接字就绪
+                    acceptConnection(*listener); // 接受新连接
                 } 
-                else if (events[n].events & EPOLLOUT) {
-                // 准备发送数据
-                pool.enqueue([fd = events[n].data.fd, this]() {
-                        this-> sendData(fd); 
-                    });  
-                }
-                else { // 如果是已连接客户端套接字就绪
-                    // 使用线程池异步处理该连接上的请求
-                    pool.enqueue([fd = events[n].data.fd, this]() {
-                        this->handleConnection(fd);
-                    });
+                else if (events[n].data.fd == wakeup_fd) { // 其他线程投递了任务（例如恢复协程）
+                    runPostedTasks();
+                } 
+                else if (events[n].data.fd == timer_fd) { // 延迟任务到期
+                    runTimers();
+                } 
+                else {
+                    // HTTP/2 连接在等待可写时仍然关注读事件，同一次事件里可能既可写又可读
+                    if (events[n].events & EPOLLOUT) {
+                        sendData(events[n].data.fd); // 准备发送数据
+                    }
+                    if (events[n].events & ~EPOLLOUT) { // 如果是已连接客户端套接字可读或对端关闭
+                        handleConnection(events[n].data.fd);
+                    }
                 }
             }
         }
@@ -73,57 +254,25 @@ public:
         return buffer.str();
     }
 
-    // 然后在 HttpServer 类中添加一个方法来处理读取操作
-void readData(int fd) {
-    std::lock_guard<std::mutex> lock(connectionsMutex);
-    auto& conn = connections[fd];
-
-    char buffer[4096]; // 临时缓冲区，用于一次性读取数据
-    ssize_t bytesRead;
-
-    while ((bytesRead = read(fd, buffer, sizeof(buffer))) > 0) {
-        conn.requestBuffer.append(buffer, bytesRead); // 将读取的数据追加到请求缓冲区
-    }
-
-    if (bytesRead == -1 && errno != EAGAIN) {
-        LOG_ERROR("Error reading from socket %d: %s", fd, strerror(errno));
-        close(fd);
-        connections.erase(fd);
-        return;
-    }
-
-    // 检查请求是否包含HTTP请求头和请求体的结束标记 "\r\n\r\n"
-    if (!conn.requestComplete && conn.requestBuffer.find("\r\n\r\n") != std::string::npos) {
-        conn.requestComplete = true; // 如果找到，标记请求为完整
-
-        // 在这里处理请求，如解析HTTP请求、生成响应等
-        // 假设我们现在直接准备响应数据
-        HttpRequest request;
-        if (request.parse(conn.requestBuffer)) { // 如果请求成功解析
-            HttpResponse response = router.routeRequest(request);
-            conn.responseData = response.toString(); // 将响应转换为字符串
-            conn.responseReady = true; // 标记响应准备好发送
-            registerWrite(fd); // 注册EPOLLOUT事件准备发送数据
+    // 开启进程内 TLS 终止，必须在 start() 之前调用
+    bool enableTls(const std::string& certFile, const std::string& keyFile) {
+        auto context = std::make_unique<TlsContext>();
+        if (!context->init(certFile, keyFile)) {
+            return false;
         }
+        tlsContext = std::move(context);
+        signal(SIGPIPE, SIG_IGN); // OpenSSL 直接 write 套接字，无法带上 MSG_NOSIGNAL
+        LOG_INFO("TLS enabled with certificate %s", certFile.c_str());
+        return true;
     }
 
-    // 如果数据还没读取完全，确保EPOLLIN事件继续被注册
-    if (!conn.requestComplete) {
-        struct epoll_event event;
-        event.events = EPOLLIN | EPOLLET; // 继续监听读事件
-        event.data.fd = fd;
-        epoll_ctl(epollfd, EPOLL_CTL_MOD, fd, &event);
-    }
-}
-
-
     void setupRoutes() {
         router.addRoute("GET", "/", [](const HttpRequest& req) {
             HttpResponse response;
             response.setStatusCode(200);
             response.setBody("Hello, World!");
             return response;
-        });
+        }, ExecClass::INLINE);
         router.addRoute("GET", "/login", [this](const HttpRequest& req) {
             HttpResponse response;
             response.setStatusCode(200);
@@ -148,89 +297,420 @@ void readData(int fd) {
             return response;
         });
 
+        // 系统调用计数，压测前后各取一次即可算出每个请求的系统调用数
+        router.addRoute("GET", "/metrics", [this](const HttpRequest&) {
+            HttpResponse response;
+            response.setStatusCode(200);
+            response.setHeader("Content-Type", "text/plain");
+            response.setBody(syscalls.toString() + (tlsContext ? tlsContext->statsString() : "") +
+                             (limiter.enabled() ? limiter.statsString() : ""));
+            return response;
+        }, ExecClass::INLINE);
+
+        // 静态页面走响应缓存：每个变体在填充缓存时读文件、压缩一次，之后直接发送
+        router.cacheRoute("GET", "/login", std::chrono::seconds(60));
+        router.cacheRoute("GET", "/register", std::chrono::seconds(60));
+        router.cacheRoute("GET", "/upload", std::chrono::seconds(60));
+
         router.setupDatabaseRoutes(db);
-        router.setupImageRoutes(db); 
+        router.setupImageRoutes(db, executors);
         // ... 添加更多路由 ...
 
     }
 
 private:
-    int server_fd, epollfd, port, max_events;
+    int epollfd, wakeup_fd, timer_fd, max_events;
+    int backlog = SOMAXCONN;
+    int reactorCpu = -1; // I/O 线程绑定的核，-1 表示不绑核
+    bool busyPoll = false;
+    int busyPollSocketUsecs = 0;
+    std::chrono::milliseconds busyPollIdle{0};
+    bool busyPollWarned = false;
+    std::vector<char> readBuffer = std::vector<char>(4096); // 只在 I/O 线程上使用
+    std::vector<std::string> endpoints; // 待监听的端点
+    std::vector<Listener> listeners;
     Router router;
     Database& db;
+    Executors executors; // 按执行类别划分的线程池
+    ResponseCache responseCache; // 开启缓存的 GET 路由使用的进程内响应缓存
     std::unordered_map<int, Connection> connections; // 使用文件描述符作为键
     std::mutex connectionsMutex; // 保护connections的互斥锁
+    std::vector<std::function<void()>> postedTasks; // 等待在 I/O 线程上执行的任务
+    std::mutex postedMutex;
+    // 延迟任务按到期时间排序，由 timerfd 唤醒；只在 I/O 线程上使用
+    std::multimap<std::chrono::steady_clock::time_point, std::function<void()>> timers;
+    SyscallCounters syscalls;
+    uint64_t nextConnectionId = 0;
+    std::unique_ptr<TlsContext> tlsContext;
+    ClientLimiter limiter;
+    TrustedProxies trustedProxies;
+    Compression::Policy compression;
+    std::unique_ptr<TrafficCapture> capture; // 只在 I/O 线程上使用
 
-    void setupServerSocket() {
-        server_fd = socket(AF_INET, SOCK_STREAM, 0);
-        struct sockaddr_in address;
-        address.sin_family = AF_INET;
-        address.sin_addr.s_addr = INADDR_ANY;
-        address.sin_port = htons(port);
-
-        int opt = 1;
-        setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    // 客户端连接在读请求阶段关注的事件；EPOLLRDHUP 让对端关闭写端时也能及时收到通知
+    static constexpr uint32_t READ_EVENTS = EPOLLIN | EPOLLRDHUP | EPOLLET;
+    // 发送遇到 EAGAIN 后才关注可写事件
+    static constexpr uint32_t WRITE_EVENTS = EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    // HTTP/2 连接上其他流的请求随时可能到达，TLS 的读写也可能互相依赖，等待可写时要继续读
+    static constexpr uint32_t DUPLEX_EVENTS = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+    static constexpr int MIN_EPOLL_BATCH = 16;
+    // 流式响应拉取下一块被执行器拒绝时的退避：首次等待 5ms，之后每次加倍，连续拒绝 5 次后放弃
+    static constexpr std::chrono::milliseconds PRODUCER_RETRY_DELAY{5};
+    static constexpr int MAX_PRODUCER_REJECTS = 5;
 
-        bind(server_fd, (struct sockaddr *)&address, sizeof(address));
-        listen(server_fd, SOMAXCONN);
+    // 任何一个端点失败都不启动，避免以不完整的监听配置运行
+    bool setupListeners() {
+        for (const auto& endpoint : endpoints) {
+            Listener listener;
+            if (!listener.open(endpoint, backlog)) {
+                listeners.clear();
+                return false;
+            }
+            LOG_INFO("Listening on %s", endpoint.c_str());
+            listeners.push_back(std::move(listener));
+        }
+        if (listeners.empty()) {
+            LOG_ERROR("No listen endpoint configured");
+            return false;
+        }
+        return true;
+    }
 
-        setNonBlocking(server_fd);
+    // 监听端点通常只有一两个，线性查找即可
+    Listener* findListener(int fd) {
+        for (auto& listener : listeners) {
+            if (listener.getFd() == fd) {
+                return &listener;
+            }
+        }
+        return nullptr;
     }
 
     void setupEpoll() {
         epollfd = epoll_create1(0);
         struct epoll_event event;
         event.events = EPOLLIN | EPOLLET;
-        event.data.fd = server_fd;
-        epoll_ctl(epollfd, EPOLL_CTL_ADD, server_fd, &event);
+        for (const auto& listener : listeners) {
+            event.data.fd = listener.getFd();
+            epoll_ctl(epollfd, EPOLL_CTL_ADD, listener.getFd(), &event);
+        }
+
+        wakeup_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        event.events = EPOLLIN;
+        event.data.fd = wakeup_fd;
+        epoll_ctl(epollfd, EPOLL_CTL_ADD, wakeup_fd, &event);
+
+        timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+        event.events = EPOLLIN;
+        event.data.fd = timer_fd;
+        epoll_ctl(epollfd, EPOLL_CTL_ADD, timer_fd, &event);
     }
 
-    void registerWrite(int fd) {
-        struct epoll_event event;
-        event.events = EPOLLOUT | EPOLLET; // 监听可写事件，使用边缘触发
+    // delay 之后在 I/O 线程上执行 fn，只能在 I/O 线程上调用
+    void postAfter(std::chrono::milliseconds delay, std::function<void()> fn) {
+        auto when = std::chrono::steady_clock::now() + delay;
+        bool earliest = timers.empty() || when < timers.begin()->first;
+        timers.emplace(when, std::move(fn));
+        if (earliest) {
+            armTimer();
+        }
+    }
+
+    // 把 timerfd 设置为最早的延迟任务的到期时间，没有任务时停止
+    void armTimer() {
+        struct itimerspec spec = {};
+        if (!timers.empty()) {
+            auto wait = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                timers.begin()->first - std::chrono::steady_clock::now()).count();
+            wait = std::max<long long>(wait, 1); // it_value 全为 0 表示停止定时器
+            spec.it_value.tv_sec = wait / 1000000000;
+            spec.it_value.tv_nsec = wait % 1000000000;
+        }
+        timerfd_settime(timer_fd, 0, &spec, nullptr);
+    }
+
+    void runTimers() {
+        uint64_t expirations;
+        ssize_t n = read(timer_fd, &expirations, sizeof(expirations));
+        (void)n;
+        auto now = std::chrono::steady_clock::now();
+        while (!timers.empty() && timers.begin()->first <= now) {
+            auto fn = std::move(timers.begin()->second);
+            timers.erase(timers.begin());
+            fn(); // 任务里可能再次调用 postAfter
+        }
+        armTimer();
+    }
+
+    void runPostedTasks() {
+        uint64_t count;
+        ssize_t n = read(wakeup_fd, &count, sizeof(count));
+        (void)n;
+        std::vector<std::function<void()>> tasks;
+        {
+            std::lock_guard<std::mutex> lock(postedMutex);
+            tasks.swap(postedTasks);
+        }
+        for (auto& task : tasks) {
+            task();
+        }
+    }
+
+    // 修改 fd 关注的事件；与缓存的当前事件相同时不发起 epoll_ctl。调用时必须持有 connectionsMutex
+    void setInterest(int fd, Connection& conn, uint32_t events) {
+        if (conn.interest == events) {
+            return;
+        }
+        struct epoll_event event = {};
+        event.events = events;
         event.data.fd = fd;
-        epoll_ctl(epollfd, EPOLL_CTL_MOD, fd, &event); // 修改fd的监听事件为EPOLLOUT
+        epoll_ctl(epollfd, EPOLL_CTL_MOD, fd, &event);
+        SyscallCounters::add(syscalls.epollCtls);
+        conn.interest = events;
     }
 
+    // 关闭连接；close 会自动把 fd 从 epoll 中移除，不需要额外的 EPOLL_CTL_DEL
+    void closeConnection(int fd) {
+        auto it = connections.find(fd);
+        if (it != connections.end()) {
+            if (it->second.tls) {
+                it->second.tls->shutdown();
+            }
+            if (!it->second.quotaClient.empty()) {
+                limiter.releaseConnection(it->second.quotaClient);
+            }
+        }
+        close(fd);
+        connections.erase(fd);
+    }
 
-    void acceptConnection() {
-        struct sockaddr_in client_addr;
+    void acceptConnection(const Listener& listener) {
+        struct sockaddr_storage client_addr;
         socklen_t client_addrlen = sizeof(client_addr);
         int client_sock;
-        while ((client_sock = accept(server_fd, (struct sockaddr *)&client_addr, &client_addrlen)) > 0) {
-            setNonBlocking(client_sock);
+        // accept4 直接返回非阻塞套接字，省去两次 fcntl
+        while ((client_sock = accept4(listener.getFd(), (struct sockaddr *)&client_addr, &client_addrlen,
+                                      SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+            SyscallCounters::add(syscalls.accepts);
+            std::string peer = peerAddress(client_addr);
+            // 反向代理的一个上游连接会先后承载许多客户端的请求，不计入任何客户端的并发名额，
+            // 请求速率按转发的客户端地址计算
+            bool trusted = listener.isUnix() || trustedProxies.contains(client_addr);
+            if (!trusted && !limiter.acquireConnection(peer)) {
+                if (!tlsContext || listener.isUnix()) {
+                    send(client_sock, tooManyRequests().data(), tooManyRequests().size(), MSG_NOSIGNAL | MSG_DONTWAIT);
+                }
+                close(client_sock);
+                client_addrlen = sizeof(client_addr);
+                continue;
+            }
             struct epoll_event event = {};
-            event.events = EPOLLIN | EPOLLET;
+            event.events = READ_EVENTS;
             event.data.fd = client_sock;
             epoll_ctl(epollfd, EPOLL_CTL_ADD, client_sock, &event);
+            SyscallCounters::add(syscalls.epollCtls);
+            if (busyPoll && busyPollSocketUsecs > 0 && !listener.isUnix()) {
+                setBusyPollOptions(client_sock);
+            }
+
+            std::lock_guard<std::mutex> lock(connectionsMutex);
+            Connection& conn = connections[client_sock];
+            conn = Connection();
+            conn.interest = READ_EVENTS;
+            conn.id = ++nextConnectionId;
+            conn.peer = std::move(peer);
+            conn.trustedPeer = trusted;
+            if (!trusted && limiter.enabled()) {
+                conn.quotaClient = conn.peer;
+            }
+            // AF_UNIX 端点只用于同机的反向代理，保持明文
+            if (tlsContext && !listener.isUnix()) {
+                conn.tls = std::make_unique<TlsStream>(*tlsContext, client_sock);
+            }
+            client_addrlen = sizeof(client_addr);
         }
         if (client_sock == -1 && (errno != EAGAIN && errno != EWOULDBLOCK)) {
             LOG_ERROR("Error accepting new connection");
         }
     }
-    void sendBadRequestResponse(int fd) {
+    // 超过 net.core.busy_read 的 SO_BUSY_POLL 需要 CAP_NET_ADMIN，失败时只提示一次，不影响连接
+    void setBusyPollOptions(int fd) {
+        int usecs = busyPollSocketUsecs;
+        int prefer = 1;
+        if (setsockopt(fd, SOL_SOCKET, SO_BUSY_POLL, &usecs, sizeof(usecs)) != 0 ||
+            setsockopt(fd, SOL_SOCKET, SO_PREFER_BUSY_POLL, &prefer, sizeof(prefer)) != 0) {
+            if (!busyPollWarned) {
+                LOG_WARNING("Failed to enable socket busy polling: %s", strerror(errno));
+                busyPollWarned = true;
+            }
+        }
+    }
+
+    static std::string peerAddress(const struct sockaddr_storage& addr) {
+        char text[INET6_ADDRSTRLEN] = "unix";
+        if (addr.ss_family == AF_INET) {
+            inet_ntop(AF_INET, &reinterpret_cast<const sockaddr_in&>(addr).sin_addr, text, sizeof(text));
+        } else if (addr.ss_family == AF_INET6) {
+            inet_ntop(AF_INET6, &reinterpret_cast<const sockaddr_in6&>(addr).sin6_addr, text, sizeof(text));
+        }
+        return text;
+    }
+
+    // 限流使用的客户端标识。只有可信反向代理的连接才采用 X-Real-IP / X-Forwarded-For，
+    // 直连的客户端可以随意伪造这些请求头，一律按对端地址计算
+    static std::string clientKey(const Connection& conn, const HttpRequest& request) {
+        if (conn.trustedPeer) {
+            std::string realIp = request.getHeader("X-Real-IP");
+            if (!realIp.empty()) {
+                return realIp;
+            }
+            // nginx 的 $proxy_add_x_forwarded_for 把它看到的对端地址追加在最后，前面的部分可能是伪造的
+            std::string forwarded = request.getHeader("X-Forwarded-For");
+            size_t comma = forwarded.rfind(',');
+            size_t start = forwarded.find_first_not_of(' ', comma == std::string::npos ? 0 : comma + 1);
+            if (start != std::string::npos) {
+                return forwarded.substr(start, forwarded.find_last_not_of(' ') + 1 - start);
+            }
+        }
+        return conn.peer;
+    }
+
+    // 请求进入 Router 之前的限流检查，调用时必须持有 connectionsMutex。
+    // 并发连接名额在 accept 时按对端地址占用，这里只检查请求速率
+    bool admitRequest(Connection& conn, const HttpRequest& request) {
+        if (!limiter.enabled()) {
+            return true;
+        }
+        return limiter.allowRequest(clientKey(conn, request));
+    }
+
+    // 429 响应在启动后不变，只序列化一次
+    static const std::string& tooManyRequests() {
+        static const std::string wire = [] {
+            HttpResponse response = HttpResponse::makeErrorResponse(429, "Too Many Requests");
+            response.setHeader("Retry-After", "1");
+            return response.toString();
+        }();
+        return wire;
+    }
+
+    void sendBadRequestResponse(int fd, Connection& conn) {
         const char* response = 
             "HTTP/1.1 400 Bad Request\r\n"
             "Content-Type: text/html\r\n"
             "Content-Length: 47\r\n"
             "\r\n"
             "<html><body><h1>400 Bad Request</h1></body></html>";
-        send(fd, response, strlen(response), 0);
+        connWrite(fd, conn, response, strlen(response));
+    }
+
+    // 套接字读写的统一入口，TLS 连接经过 OpenSSL，返回值语义与 read/send 相同
+    static ssize_t connRead(int fd, Connection& conn, char* buf, size_t len) {
+        return conn.tls ? conn.tls->read(buf, len) : read(fd, buf, len);
     }
 
-    // sendData函数用于将服务器生成的响应数据发送给指定文件描述符（fd）所关联的客户端。
+    // MSG_NOSIGNAL 避免对端已关闭时产生 SIGPIPE
+    static ssize_t connWrite(int fd, Connection& conn, const char* buf, size_t len) {
+        return conn.tls ? conn.tls->write(buf, len) : send(fd, buf, len, MSG_NOSIGNAL);
+    }
+
+    // TLS 连接在 kTLS 生效时同样走 sendfile 零拷贝路径，否则由 TlsStream 读文件后加密发送
+    static ssize_t connSendfile(int fd, Connection& conn, off_t* offset, size_t count) {
+        return conn.tls ? conn.tls->sendfile(conn.file->fd, offset, count) : sendfile(fd, conn.file->fd, offset, count);
+    }
+
+    // TLS 握手，调用时必须持有 connectionsMutex。返回 false 表示握手尚未完成或连接已关闭
+    bool continueHandshake(int fd, Connection& conn) {
+        switch (conn.tls->handshake()) {
+            case TlsStream::Handshake::DONE:
+                setInterest(fd, conn, READ_EVENTS);
+                return true;
+            case TlsStream::Handshake::WANT_READ:
+                setInterest(fd, conn, READ_EVENTS);
+                return false;
+            case TlsStream::Handshake::WANT_WRITE:
+                setInterest(fd, conn, DUPLEX_EVENTS);
+                return false;
+            case TlsStream::Handshake::FAILED:
+                break;
+        }
+        LOG_WARNING("TLS handshake failed on socket %d", fd);
+        closeConnection(fd);
+        return false;
+    }
+
+    // sendData函数在EPOLLOUT事件或生产者完成后继续发送指定连接上的响应数据。
     void sendData(int fd) {
         // 使用std::lock_guard确保在并发环境下对connections容器的安全访问
         std::lock_guard<std::mutex> lock(connectionsMutex);
+        auto it = connections.find(fd);
+        if (it == connections.end()) {
+            return;
+        }
+        if (it->second.tls && !it->second.tls->isEstablished()) {
+            continueHandshake(fd, it->second); // 握手在等待可写
+            return;
+        }
+        flushResponse(fd, it->second);
+    }
 
-        // 从connections映射表中获取与当前fd对应的连接信息
-        auto& conn = connections[fd];
-
+    // 尽可能多地发送响应数据。响应就绪时直接尝试写，只有遇到 EAGAIN 才注册 EPOLLOUT，
+    // 小响应通常一次 send 就能完成，不需要额外的 epoll_ctl 和一次事件循环。
+    // 调用时必须持有 connectionsMutex。
+    void flushResponse(int fd, Connection& conn) {
         // 当已发送的数据量小于总响应数据大小时，继续循环发送剩余数据
-        while (conn.sentBytes < conn.responseData.size()) {
-            // 调用send系统调用发送剩余数据
-            ssize_t sent = send(fd, conn.responseData.c_str() + conn.sentBytes,
-                                conn.responseData.size() - conn.sentBytes, 0);
+        while (true) {
+            if (conn.sentBytes == conn.responseData.size()) {
+                // HTTP/2：发送缓冲区清空后继续生成受流量控制的 DATA 帧，没有数据时回到只读
+                if (conn.h2) {
+                    conn.responseData.clear();
+                    conn.sentBytes = 0;
+                    conn.h2->pump();
+                    conn.h2->takeOutput(conn.responseData);
+                    if (!conn.responseData.empty()) {
+                        continue;
+                    }
+                    if (conn.h2->shouldClose()) {
+                        closeConnection(fd);
+                        return;
+                    }
+                    setInterest(fd, conn, READ_EVENTS);
+                    return;
+                }
+                // 响应头已发送，文件响应直接由内核从页缓存发送到套接字
+                if (conn.fileRemaining > 0) {
+                    ssize_t sent = connSendfile(fd, conn, &conn.fileOffset, conn.fileRemaining);
+                    SyscallCounters::add(syscalls.writes);
+                    if (sent > 0) {
+                        conn.fileRemaining -= sent;
+                        continue;
+                    }
+                    if (sent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                        setInterest(fd, conn, conn.tls ? DUPLEX_EVENTS : WRITE_EVENTS);
+                        return; // 等待EPOLLOUT事件
+                    }
+                    LOG_ERROR("Error sending file to socket %d: %s", fd, strerror(errno));
+                    closeConnection(fd);
+                    return;
+                }
+                // 发送缓冲区已清空，流式响应继续拉取下一块
+                if (conn.producerDone) {
+                    break;
+                }
+                if (conn.producing) {
+                    return;
+                }
+                conn.responseData.clear();
+                conn.sentBytes = 0;
+                if (!pullNextChunk(fd, conn)) {
+                    return; // 等生产者完成或退避重试后继续发送；执行器多次拒绝时连接已关闭
+                }
+                continue;
+            }
+            // 发送剩余数据
+            ssize_t sent = connWrite(fd, conn, conn.responseData.c_str() + conn.sentBytes,
+                                     conn.responseData.size() - conn.sentBytes);
+            SyscallCounters::add(syscalls.writes);
 
             // 发送成功
             if (sent > 0) {
@@ -239,6 +719,7 @@ private:
             }
             // 发送失败但错误为EAGAIN或EWOULDBLOCK，表示套接字暂时不可写，需要等待下一次变为可写时再尝试发送
             else if (sent == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                setInterest(fd, conn, (conn.h2 || conn.tls) ? DUPLEX_EVENTS : WRITE_EVENTS);
                 return; // 返回并等待EPOLLOUT事件触发后再继续发送
             }
             // 其他错误情况，如网络故障等
@@ -247,88 +728,530 @@ private:
                 LOG_ERROR("Error sending data to socket %d", fd);
                 
                 // 关闭连接并从连接列表中移除该连接信息
-                close(fd);
-                connections.erase(fd);
-
-                // 结束函数执行
+                closeConnection(fd);
                 return;
             }
         }
 
         // 数据已全部发送完毕，关闭连接并清理连接状态
-        close(fd);
-        connections.erase(fd);
+        closeConnection(fd);
     }
 
 
     
 void handleConnection(int fd) {
-    // 首先检查这个fd是否已经在connections中有记录
+    std::unique_lock<std::mutex> lock(connectionsMutex);
+    // 连接状态在 accept 时创建；找不到说明连接已经关闭，这是一个过期事件
     auto connIt = connections.find(fd);
     if (connIt == connections.end()) {
-        // 如果是新连接，初始化连接状态并加入到connections映射中
-        Connection newConn;
-        std::lock_guard<std::mutex> lock(connectionsMutex);
-        connIt = connections.insert({fd, std::move(newConn)}).first;
+        return;
     }
-
     auto& conn = connIt->second;
 
-    // 检查是否已经读取到完整的请求
-    if (!conn.requestComplete) {
-        char buffer[4096]; // 临时缓冲区，用于一次性读取数据
-        ssize_t bytes_read;
+    // 请求已经交给执行器处理，忽略后续的读事件，避免处理期间 fd 被关闭复用；
+    // TLS 连接的发送可能在等待读（例如对端的 KeyUpdate），此时继续发送
+    if (conn.requestComplete) {
+        if (conn.tls && conn.responseReady) {
+            flushResponse(fd, conn);
+        }
+        return;
+    }
+
+    if (conn.tls && !conn.tls->isEstablished() && !continueHandshake(fd, conn)) {
+        return;
+    }
+
+    ssize_t bytes_read;
+
+    // 边缘触发模式下需要一直读到 EAGAIN
+    while ((bytes_read = connRead(fd, conn, readBuffer.data(), readBuffer.size())) > 0) {
+        SyscallCounters::add(syscalls.reads);
+        conn.requestBuffer.append(readBuffer.data(), bytes_read);
+    }
+    SyscallCounters::add(syscalls.reads);
+
+    if (bytes_read == -1 && errno != EAGAIN && errno != EWOULDBLOCK) {
+        // 读取出错
+        LOG_ERROR("Error reading from socket %d: %s", fd, strerror(errno));
+        closeConnection(fd);
+        return;
+    }
+
+    // 以 HTTP/2 连接前言开头的是 prior-knowledge 方式的 h2c 连接
+    if (!conn.h2 && Http2Session::hasPreface(conn.requestBuffer)) {
+        if (conn.requestBuffer.size() < Http2Session::PREFACE_SIZE) {
+            if (bytes_read == 0) {
+                closeConnection(fd);
+            }
+            return; // 前言还没有收齐
+        }
+        conn.h2 = std::make_unique<Http2Session>();
+    }
+    if (conn.h2) {
+        serveHttp2(fd, conn, lock, bytes_read == 0);
+        return;
+    }
 
-        // 尝试读取数据
-        bytes_read = read(fd, buffer, sizeof(buffer));
-        if (bytes_read > 0) {
-            // 将读取的数据追加到请求缓冲区
-            conn.requestBuffer.append(buffer, bytes_read);
+    // 检查是否读取到完整的请求头和请求体
+    size_t requestLength = 0;
+    Framing framing = getRequestLength(conn.requestBuffer, requestLength);
+    if (framing == Framing::INVALID) {
+        LOG_WARNING("Invalid Content-Length on socket %d", fd);
+        sendBadRequestResponse(fd, conn);
+        closeConnection(fd);
+        return;
+    }
+    if (framing == Framing::TOO_LARGE) {
+        LOG_WARNING("Request body too large on socket %d", fd);
+        std::string response = HttpResponse::makeErrorResponse(413, "Payload Too Large").toString();
+        connWrite(fd, conn, response.data(), response.size());
+        closeConnection(fd);
+        return;
+    }
+    if (framing == Framing::INCOMPLETE) {
+        if (bytes_read == 0) {
+            // 客户端在请求发完之前关闭了连接
+            closeConnection(fd);
+        }
+        return; // 请求还不完整，继续等待EPOLLIN事件
+    }
+    // 对端只关闭了写端（半关闭）时请求已经完整，仍然需要发送响应
+    conn.requestComplete = true;
+    SyscallCounters::add(syscalls.requests);
+    if (capture) {
+        capture->record(conn.requestBuffer.data(), requestLength);
+    }
 
-            // 检查是否读取到HTTP请求的结束标记"\r\n\r\n"
-            if (conn.requestBuffer.find("\r\n\r\n") != std::string::npos) {
-                conn.requestComplete = true; // 标记请求为完整
+    // 处理完整的请求
+    auto request = std::make_shared<HttpRequest>();
+    if (!request->parse(conn.requestBuffer)) {
+        // 请求解析失败
+        LOG_WARNING("Failed to parse request for socket %d", fd);
+        sendBadRequestResponse(fd, conn); // 发送400 Bad Request响应
+        closeConnection(fd);
+        return;
+    }
+
+    // "Upgrade: h2c"：回复 101 后切换到 HTTP/2，这个请求的响应在流 1 上返回
+    if (bytes_read != 0 && request->getMethodString() == "GET" &&
+        request->getHeader("Upgrade").find("h2c") != std::string::npos &&
+        !request->getHeader("HTTP2-Settings").empty()) {
+        auto session = std::make_unique<Http2Session>();
+        if (session->acceptUpgrade(request->getHeader("HTTP2-Settings"), request)) {
+            conn.responseData = "HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n";
+            conn.sentBytes = 0;
+            conn.requestBuffer.erase(0, requestLength); // 客户端可能已经紧接着发送了连接前言
+            conn.requestComplete = false;
+            conn.h2 = std::move(session);
+            serveHttp2(fd, conn, lock, false);
+            return;
+        }
+    }
+    if (!admitRequest(conn, *request)) {
+        conn.responseData = tooManyRequests();
+        conn.responseReady = true;
+        conn.sentBytes = 0;
+        flushResponse(fd, conn);
+        return;
+    }
+    lock.unlock();
+
+    dispatchRequest(request, [this, fd](const HttpResponse& response) {
+        completeResponse(fd, response);
+    }, [this, fd](const std::string& data) {
+        completeRawResponse(fd, data);
+    });
+}
+
+    // 把读到的数据交给 HTTP/2 会话，写出协议帧（SETTINGS ACK、WINDOW_UPDATE 等），
+    // 然后在锁外把新完成的各个流的请求派发出去；各个流的响应互不等待。
+    // 调用时必须通过 lock 持有 connectionsMutex，返回时已经释放。
+    void serveHttp2(int fd, Connection& conn, std::unique_lock<std::mutex>& lock, bool peerClosed) {
+        std::string input;
+        input.swap(conn.requestBuffer);
+        conn.h2->receive(input.data(), input.size());
+        auto requests = conn.h2->takeRequests();
+        uint64_t connId = conn.id;
+        if (peerClosed) {
+            closeConnection(fd);
+            return;
+        }
+        std::vector<uint32_t> rejected;
+        for (auto it = requests.begin(); it != requests.end();) {
+            if (admitRequest(conn, *it->second)) {
+                ++it;
             } else {
-                // 如果请求还不完整，继续监听EPOLLIN事件
+                rejected.push_back(it->first);
+                it = requests.erase(it);
+            }
+        }
+        conn.h2->takeOutput(conn.responseData);
+        flushResponse(fd, conn); // 可能因为 GOAWAY 关闭连接，之后的响应会被丢弃
+        lock.unlock();
+
+        for (uint32_t streamId : rejected) {
+            HttpResponse response = HttpResponse::makeErrorResponse(429, "Too Many Requests");
+            response.setHeader("Retry-After", "1");
+            completeStream(fd, connId, streamId, response);
+        }
+        for (auto& entry : requests) {
+            SyscallCounters::add(syscalls.requests);
+            uint32_t streamId = entry.first;
+            dispatchRequest(entry.second, [this, fd, connId, streamId](const HttpResponse& response) {
+                completeStream(fd, connId, streamId, response);
+            }, nullptr);
+        }
+    }
+
+    // HTTP/2 流的响应完成：编码成 HEADERS/DATA 帧追加到连接的发送缓冲区
+    void completeStream(int fd, uint64_t connId, uint32_t streamId, const HttpResponse& response) {
+        if (response.isStreaming()) {
+            // HTTP/2 没有 chunked 编码，流式响应体先在生产者的执行器上读完，再按 DATA 帧发送
+            auto full = std::make_shared<HttpResponse>(response);
+            bool accepted = executors.dispatch(full->getProducerExec(), [this, fd, connId, streamId, full]() {
+                full->materialize();
+                completeStream(fd, connId, streamId, *full);
+            });
+            if (!accepted) {
+                completeStream(fd, connId, streamId, HttpResponse::makeErrorResponse(503, "Service Unavailable"));
+            }
+            return;
+        }
+        HttpResponse owned(response); // 在锁外复制响应体，锁内只移动
+        {
+            std::lock_guard<std::mutex> lock(connectionsMutex);
+            auto it = connections.find(fd);
+            if (it == connections.end() || it->second.id != connId || !it->second.h2) {
+                return; // 连接已经关闭
+            }
+            auto& conn = it->second;
+            conn.h2->submitResponse(streamId, std::move(owned));
+            conn.h2->takeOutput(conn.responseData);
+            if (onReactorThread()) {
+                flushResponse(fd, conn);
                 return;
             }
-        } else if (bytes_read == -1 && errno != EAGAIN) {
-            // 读取出错
-            LOG_ERROR("Error reading from socket %d: %s", fd, strerror(errno));
-            close(fd);
-            connections.erase(fd);
+        }
+        post([this, fd]() { sendData(fd); }); // 与 completeResponse 相同，发送留给 I/O 线程
+    }
+
+    // 开启缓存的路由先查响应缓存，并发未命中时只让一个请求执行处理函数。
+    // respond 负责把响应交回对应的连接或 HTTP/2 流；respondRaw 非空时缓存命中直接发送序列化好的报文。
+    void dispatchRequest(std::shared_ptr<HttpRequest> request, std::function<void(const HttpResponse&)> respond,
+                         std::function<void(const std::string&)> respondRaw) {
+        // 需要登录的路由先在 I/O 线程上校验会话令牌
+        if (!router.authenticate(*request)) {
+            respond(HttpResponse::makeErrorResponse(401, "Unauthorized"));
             return;
-        } else if (bytes_read == 0) {
-            // 客户端关闭了连接
-            close(fd);
-            connections.erase(fd);
+        }
+
+        bool gzip = compression.enabled && Compression::acceptsGzip(request->getHeader("Accept-Encoding"));
+        std::chrono::milliseconds ttl = router.getCacheTtl(*request);
+        if (ttl.count() == 0) {
+            runUncached(request, gzip, respond);
             return;
         }
+
+        // 路由声明的查询参数分别缓存；压缩与否是同一资源的两个变体，也分别缓存
+        std::string key = router.getCacheKey(*request) + (gzip ? "|gzip" : "");
+        std::shared_ptr<const ResponseCache::Cached> cached;
+        // leader 的流式响应太大没有缓存时不能共享给等待者，等待者回到 I/O 线程各自执行处理函数
+        auto waiter = [this, request, gzip, respond](const HttpResponse& response) {
+            if (!response.isStreaming()) {
+                respond(response);
+                return;
+            }
+            post([this, request, gzip, respond]() { runUncached(request, gzip, respond); });
+        };
+        auto lookup = responseCache.lookup(key, cached, waiter);
+        if (lookup == ResponseCache::Lookup::HIT) {
+            if (respondRaw) {
+                respondRaw(cached->wire);
+            } else {
+                respond(cached->response);
+            }
+            return;
+        }
+        if (lookup == ResponseCache::Lookup::WAITING) {
+            return; // leader 完成时会回调
+        }
+
+        // 写入缓存的响应在 TTL 内只压缩这一次，用最高压缩级别，之后命中时直接发送压缩好的报文
+        runHandler(request, [this, gzip, respond, key, ttl](HttpResponse result, bool onReactor) {
+            encodeResponse(std::move(result), gzip, Z_BEST_COMPRESSION, onReactor,
+                           [this, respond, key, ttl](const HttpResponse& encoded) {
+                fillCache(key, ttl, encoded, respond);
+            });
+        });
     }
 
-    // 处理完整的请求
-    if (conn.requestComplete && !conn.responseReady) {
-        HttpRequest request;
-        if (request.parse(conn.requestBuffer)) {
-            // 如果请求成功解析，生成响应
-            HttpResponse response = router.routeRequest(request);
-            conn.responseData = response.toString();
+    void runUncached(std::shared_ptr<HttpRequest> request, bool gzip, std::function<void(const HttpResponse&)> respond) {
+        runHandler(request, [this, gzip, respond](HttpResponse response, bool onReactor) {
+            encodeResponse(std::move(response), gzip, compression.level, onReactor, respond);
+        });
+    }
+
+    // 缓存 leader 拿到响应后写入缓存并唤醒等待者
+    void fillCache(const std::string& key, std::chrono::milliseconds ttl, const HttpResponse& result,
+                   std::function<void(const HttpResponse&)> respond) {
+        auto response = std::make_shared<HttpResponse>(result);
+        auto finish = [this, respond, key, ttl, response]() {
+            // 缓存保存完整响应，流式响应体需要先读完；超过缓存条目上限时停止读取，剩余部分照常流式发送，不缓存
+            response->materialize(responseCache.maxEntrySize());
+            responseCache.complete(key, *response, ttl);
+            respond(*response);
+        };
+        if (!response->isStreaming()) {
+            finish();
+        } else if (!executors.dispatch(response->getProducerExec(), finish)) {
+            responseCache.complete(key, HttpResponse::makeErrorResponse(503, "Service Unavailable"), ttl);
+            respond(HttpResponse::makeErrorResponse(503, "Service Unavailable"));
+        }
+    }
+
+    // 按协商结果压缩响应后交给 done，压缩不占用 I/O 线程：
+    // 已经在线程池上时就地压缩；INLINE 路由和协程在 I/O 线程上完成，转交给 WORKER；
+    // 流式响应只包装生产者，每块随生产者在它自己的执行器上压缩
+    void encodeResponse(HttpResponse response, bool gzip, int level, bool onReactor,
+                        std::function<void(const HttpResponse&)> done) {
+        if (!compression.enabled || !Compression::isCompressible(response)) {
+            done(response);
+            return;
+        }
+        response.setHeader("Vary", "Accept-Encoding");
+        if (!gzip || (!response.isStreaming() && response.getBody().size() < compression.minSize)) {
+            done(response);
+            return;
+        }
+        if (response.isStreaming()) {
+            Compression::compressStream(response, level);
+            done(response);
+            return;
+        }
+        if (!onReactor) {
+            Compression::compressBody(response, level);
+            done(response);
+            return;
+        }
+        auto pending = std::make_shared<HttpResponse>(std::move(response));
+        bool accepted = executors.dispatch(ExecClass::WORKER, [pending, level, done]() {
+            Compression::compressBody(*pending, level);
+            done(*pending);
+        });
+        if (!accepted) {
+            done(*pending); // WORKER 繁忙时不压缩，照常发送
+        }
+    }
+
+    // 按路由声明的执行类别运行处理函数，INLINE 路由直接在当前 I/O 线程上完成。
+    // done 的第二个参数表示它是否在 I/O 线程上被调用
+    void runHandler(std::shared_ptr<HttpRequest> request, std::function<void(HttpResponse, bool)> done) {
+        if (const Router::AsyncHandlerFunc* handler = router.getAsyncHandler(*request)) {
+            // 协程处理函数在 I/O 线程上启动；request 由回调持有，保证协程运行期间有效
+            (*handler)(*request).start(
+                [done, request](HttpResponse response) {
+                    done(std::move(response), true);
+                },
+                [done, request](std::exception_ptr error) {
+                    try {
+                        std::rethrow_exception(error);
+                    } catch (const std::exception& e) {
+                        LOG_ERROR("Async handler failed for %s: %s", request->getPath().c_str(), e.what());
+                    } catch (...) {
+                        LOG_ERROR("Async handler failed for %s", request->getPath().c_str());
+                    }
+                    done(HttpResponse::makeErrorResponse(500, "Internal Server Error"), true);
+                });
+            return;
+        }
+
+        ExecClass exec = router.getExecClass(*request);
+        bool accepted = executors.dispatch(exec, [this, request, done, exec]() {
+            done(router.routeRequest(*request), exec == ExecClass::INLINE);
+        });
+        if (!accepted) {
+            // 对应执行器的队列已满，快速失败而不是拖慢其他类别的请求
+            LOG_WARNING("Executor queue full, rejecting request for %s", request->getPath().c_str());
+            done(HttpResponse::makeErrorResponse(503, "Service Unavailable"), true);
+        }
+    }
+
+    // 直接发送已经序列化好的响应（例如缓存命中）
+    void completeRawResponse(int fd, const std::string& data) {
+        std::string copy = data; // 在锁外复制
+        {
+            std::lock_guard<std::mutex> lock(connectionsMutex);
+            auto it = connections.find(fd);
+            if (it == connections.end()) {
+                return;
+            }
+            auto& conn = it->second;
+            conn.responseData.swap(copy);
             conn.responseReady = true;
             conn.sentBytes = 0;
-            // 注册EPOLLOUT事件，准备发送响应数据
-            registerWrite(fd);
-        } else {
-            // 请求解析失败
-            LOG_WARNING("Failed to parse request for socket %d", fd);
-            sendBadRequestResponse(fd); // 发送400 Bad Request响应
-            close(fd);
-            connections.erase(fd);
+            if (onReactorThread()) {
+                flushResponse(fd, conn); // 先直接尝试发送，写不完才等待EPOLLOUT
+                return;
+            }
         }
+        post([this, fd]() { sendData(fd); });
     }
-}
 
+    // 处理函数完成后保存响应数据并发送。序列化在锁外完成，锁只保护连接查找和状态更新；
+    // 在线程池中完成的响应交给 I/O 线程发送，工作线程不会持锁执行 send/sendfile/SSL_write，
+    // 也不会与 I/O 线程的读争用 connectionsMutex
+    void completeResponse(int fd, const HttpResponse& response) {
+        std::string data = response.toString();
+        {
+            std::lock_guard<std::mutex> lock(connectionsMutex);
+            auto it = connections.find(fd);
+            if (it == connections.end()) {
+                return;
+            }
+            auto& conn = it->second;
+            conn.responseData.swap(data); // 旧缓冲区在锁外释放
+            conn.responseReady = true;
+            conn.sentBytes = 0;
+            if (response.isStreaming()) {
+                conn.bodyProducer = response.getBodyProducer();
+                conn.producerExec = response.getProducerExec();
+                conn.producerDone = false;
+            }
+            if (response.getFileBody()) {
+                conn.file = response.getFileBody();
+                conn.fileOffset = response.getFileOffset();
+                conn.fileRemaining = response.getFileLength();
+            }
+            if (onReactorThread()) {
+                flushResponse(fd, conn); // 先直接尝试发送，写不完才等待EPOLLOUT
+                return;
+            }
+        }
+        post([this, fd]() { sendData(fd); });
+    }
 
+    bool onReactorThread() {
+        return ResumeExecutor::current() == this;
+    }
 
+    // 在生产者所属的执行器上拉取下一块数据，完成后回到 I/O 线程继续发送。
+    // 调用时必须持有 connectionsMutex；返回 true 表示数据已经就绪，可以继续发送。
+    // 返回 false 时连接可能已经因执行器多次拒绝而关闭，调用方不能再访问 conn。
+    bool pullNextChunk(int fd, Connection& conn) {
+        auto producer = conn.bodyProducer;
+        if (conn.producerExec == ExecClass::INLINE) {
+            std::string chunk;
+            bool more = (*producer)(chunk);
+            appendProduced(conn, chunk, more);
+            return true;
+        }
+
+        conn.producing = true;
+        bool accepted = executors.dispatch(conn.producerExec, [this, fd, producer]() {
+            std::string chunk;
+            bool more;
+            try {
+                more = (*producer)(chunk);
+            } catch (const std::exception& e) {
+                LOG_ERROR("Body producer failed on socket %d: %s", fd, e.what());
+                more = false;
+            }
+            {
+                std::lock_guard<std::mutex> lock(connectionsMutex);
+                auto it = connections.find(fd);
+                if (it == connections.end()) {
+                    return;
+                }
+                appendProduced(it->second, chunk, more);
+                it->second.producing = false;
+            }
+            post([this, fd]() { sendData(fd); });
+        });
+        if (accepted) {
+            conn.producerRejects = 0;
+            return false;
+        }
+        // 执行器队列已满。响应头已经发出，无法再回 503：退避一段时间后由定时器重试，
+        // 不立即重新投递，否则 I/O 线程会空转等待队列腾出位置。等待期间 producing 保持为 true，
+        // 其他可写事件不会提前拉取。连续多次被拒绝才放弃：不发结束块直接关闭连接，
+        // 客户端据此知道响应体不完整
+        if (++conn.producerRejects > MAX_PRODUCER_REJECTS) {
+            LOG_WARNING("Executor queue full, aborting streamed response on socket %d", fd);
+            closeConnection(fd);
+            return false;
+        }
+        uint64_t connId = conn.id;
+        postAfter(PRODUCER_RETRY_DELAY * (1 << (conn.producerRejects - 1)), [this, fd, connId]() {
+            std::lock_guard<std::mutex> lock(connectionsMutex);
+            auto it = connections.find(fd);
+            if (it == connections.end() || it->second.id != connId) {
+                return; // 连接已经关闭
+            }
+            it->second.producing = false;
+            flushResponse(fd, it->second);
+        });
+        return false;
+    }
+
+    static void appendProduced(Connection& conn, const std::string& chunk, bool more) {
+        if (!chunk.empty()) {
+            HttpResponse::appendChunk(conn.responseData, chunk);
+        }
+        if (!more) {
+            HttpResponse::appendChunk(conn.responseData, ""); // 结束块
+            conn.producerDone = true;
+        }
+    }
+
+    // 请求头以 "\r\n\r\n" 结束，若带有 Content-Length 还需要收齐请求体。
+    // 返回完整请求的字节数，请求还不完整时返回 npos
+    enum class Framing { INCOMPLETE, COMPLETE, INVALID, TOO_LARGE };
+
+    // 根据请求头中的 Content-Length 判断请求是否完整，完整时 length 为整个请求的长度。
+    // 只在头部范围内查找；头部名称不区分大小写，冒号后允许空白。
+    // 值不是十进制数字、多个 Content-Length 互相矛盾时返回 INVALID，超过 MAX_BODY_SIZE 时返回 TOO_LARGE
+    static Framing getRequestLength(const std::string& buffer, size_t& length) {
+        size_t headerEnd = buffer.find("\r\n\r\n");
+        if (headerEnd == std::string::npos) {
+            return Framing::INCOMPLETE;
+        }
+        static const char NAME[] = "content-length";
+        static const size_t NAME_SIZE = sizeof(NAME) - 1;
+        size_t contentLength = 0;
+        bool seen = false;
+        // 跳过请求行，逐行检查头部
+        for (size_t line = buffer.find("\r\n") + 2; line < headerEnd;) {
+            size_t lineEnd = buffer.find("\r\n", line);
+            if (lineEnd - line > NAME_SIZE && buffer[line + NAME_SIZE] == ':' &&
+                strncasecmp(buffer.data() + line, NAME, NAME_SIZE) == 0) {
+                size_t p = line + NAME_SIZE + 1;
+                size_t q = lineEnd;
+                while (p < q && (buffer[p] == ' ' || buffer[p] == '\t')) ++p;
+                while (q > p && (buffer[q - 1] == ' ' || buffer[q - 1] == '\t')) --q;
+                if (p == q) {
+                    return Framing::INVALID;
+                }
+                size_t value = 0;
+                for (; p < q; ++p) {
+                    if (buffer[p] < '0' || buffer[p] > '9') {
+                        return Framing::INVALID;
+                    }
+                    value = value * 10 + (buffer[p] - '0');
+                    if (value > HttpRequest::MAX_BODY_SIZE) {
+                        return Framing::TOO_LARGE; // 在溢出之前就已经超限
+                    }
+                }
+                if (seen && value != contentLength) {
+                    return Framing::INVALID;
+                }
+                seen = true;
+                contentLength = value;
+            }
+            line = lineEnd + 2;
+        }
+        length = headerEnd + 4 + contentLength;
+        return buffer.size() >= length ? Framing::COMPLETE : Framing::INCOMPLETE;
+    }
 
     void setNonBlocking(int sock) {
         int flags = fcntl(sock, F_GETFL, 0);
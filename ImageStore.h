@@ -0,0 +1,134 @@
+#pragma once
+#include "Hash.h"
+#include "Logger.h"
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <functional>
+
+// ImageStore 按内容寻址保存上传的图片。
+// 键为内容的 XXH64 十六进制值加原始扩展名，文件存放在 images/<前两位>/<三四位>/<键> 下，
+// 相同内容只写一次；哈希相同但内容不同时通过 "-1"、"-2" 后缀区分。
+// 引用计数记录在数据库中，由调用方通过 Database::acquireBlob/releaseBlob 维护。
+// ImageStore 只负责定位 blob，实际落盘交给 WritePipeline。
+// 去重命中的文件可能正被最后一个引用的释放删除：增加引用前确认文件仍在、释放后删除文件，
+// 这两段都要在 lockFor(key) 下执行，否则新记录可能指向刚被删掉的文件。
+class ImageStore {
+public:
+    struct Blob {
+        std::string key;  // 内容键，同时作为下载 URL 中的文件名
+        std::string path; // 磁盘上的相对路径
+        bool needsWrite;  // 磁盘上还没有这份内容，需要写入
+    };
+
+    explicit ImageStore(const std::string& root = "images/") : root(root) {}
+
+    // 计算内容键并检查去重，返回内容应当存放的 Blob；需要写入时会预先创建分片目录。
+    // 会读取已有文件做碰撞检查，应在工作线程上调用。
+    bool locate(const std::string& content, const std::string& fileName, Blob& blob) {
+        std::string base = XXHash64::toHex(XXHash64::hash(content.data(), content.size()));
+        std::string ext = extensionOf(fileName);
+
+        for (int n = 0; n < 16; ++n) {
+            std::string key = base + (n == 0 ? "" : "-" + std::to_string(n)) + ext;
+            std::string path = pathFor(key);
+            struct stat st;
+            if (stat(path.c_str(), &st) == 0) {
+                if (static_cast<size_t>(st.st_size) == content.size() && sameContent(path, content)) {
+                    blob = Blob{key, path, false}; // 已有相同内容，不再写盘
+                    return true;
+                }
+                LOG_WARNING("Hash collision on image blob %s", key.c_str());
+                continue; // 哈希碰撞，尝试下一个后缀
+            }
+            if (!makeShardDirs(key)) {
+                return false;
+            }
+            blob = Blob{key, path, true};
+            return true;
+        }
+        LOG_ERROR("Too many hash collisions for image %s", fileName.c_str());
+        return false;
+    }
+
+    // 引用计数归零后删除文件
+    void remove(const std::string& key) {
+        unlink(pathFor(key).c_str());
+    }
+
+    bool exists(const std::string& key) const {
+        struct stat st;
+        return stat(pathFor(key).c_str(), &st) == 0;
+    }
+
+    // 按键分段的锁，单进程内串行化同一个 blob 的引用增加与删除
+    std::mutex& lockFor(const std::string& key) {
+        return locks[XXHash64::hash(key.data(), key.size()) % LOCK_STRIPES];
+    }
+
+    // 内容键对应的分片路径
+    std::string pathFor(const std::string& key) const {
+        return root + key.substr(0, 2) + "/" + key.substr(2, 2) + "/" + key;
+    }
+
+    // 判断下载请求中的文件名是否为内容键（16 位十六进制开头）
+    static bool isKey(const std::string& name) {
+        if (name.size() < 16) return false;
+        for (size_t i = 0; i < 16; ++i) {
+            if (!isxdigit(static_cast<unsigned char>(name[i]))) return false;
+        }
+        return true;
+    }
+
+private:
+    static std::string extensionOf(const std::string& fileName) {
+        size_t dot = fileName.rfind('.');
+        if (dot == std::string::npos || fileName.size() - dot > 8) {
+            return "";
+        }
+        std::string ext = fileName.substr(dot);
+        for (auto& c : ext) {
+            c = tolower(c);
+            if (c != '.' && !isalnum(static_cast<unsigned char>(c))) return "";
+        }
+        return ext;
+    }
+
+    bool makeShardDirs(const std::string& key) {
+        std::string dirs[] = {root, root + key.substr(0, 2), root + key.substr(0, 2) + "/" + key.substr(2, 2)};
+        for (const auto& dir : dirs) {
+            if (mkdir(dir.c_str(), 0755) == -1 && errno != EEXIST) {
+                LOG_ERROR("Failed to create directory: %s", dir.c_str());
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // 逐块比较磁盘上的文件与待写入内容，用于确认哈希相同是否真的是同一内容
+    static bool sameContent(const std::string& path, const std::string& content) {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0) return false;
+        char buffer[65536];
+        size_t offset = 0;
+        bool same = true;
+        ssize_t n;
+        while (same && (n = read(fd, buffer, sizeof(buffer))) > 0) {
+            if (offset + n > content.size() || memcmp(buffer, content.data() + offset, n) != 0) {
+                same = false;
+            }
+            offset += n;
+        }
+        close(fd);
+        return same && offset == content.size();
+    }
+
+    static constexpr size_t LOCK_STRIPES = 64;
+
+    std::string root;
+    std::mutex locks[LOCK_STRIPES];
+};
@@ -0,0 +1,173 @@
+#pragma once
+#include "Logger.h"
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+
+// Listener 是服务器的一个监听端点，同一个事件循环可以同时监听多个端点。
+// 端点写法：
+//     "8080" 或 "0.0.0.0:8080"                 TCP
+//     "unix:/run/myapp/http.sock"              AF_UNIX 流式套接字，权限默认 0660
+//     "unix:/run/myapp/http.sock:0666"         指定权限（八进制）
+// 同机的 nginx 通过 AF_UNIX 转发时不经过 TCP 协议栈。
+class Listener {
+public:
+    Listener() = default;
+    Listener(const Listener&) = delete;
+    Listener& operator=(const Listener&) = delete;
+
+    Listener(Listener&& other) noexcept
+        : fd(std::exchange(other.fd, -1)), unixPath(std::move(other.unixPath)), endpoint(std::move(other.endpoint)) {
+        other.unixPath.clear();
+    }
+
+    Listener& operator=(Listener&& other) noexcept {
+        if (this != &other) {
+            closeListener();
+            fd = std::exchange(other.fd, -1);
+            unixPath = std::move(other.unixPath);
+            endpoint = std::move(other.endpoint);
+            other.unixPath.clear();
+        }
+        return *this;
+    }
+
+    ~Listener() {
+        closeListener();
+    }
+
+    // 创建、绑定并监听端点，失败时记录日志并返回 false
+    bool open(const std::string& spec, int backlog) {
+        endpoint = spec;
+        if (spec.compare(0, 5, "unix:") == 0) {
+            return openUnix(spec.substr(5), backlog);
+        }
+        return openTcp(spec, backlog);
+    }
+
+    int getFd() const {
+        return fd;
+    }
+
+    bool isUnix() const {
+        return !unixPath.empty();
+    }
+
+    const std::string& getEndpoint() const {
+        return endpoint;
+    }
+
+private:
+    bool openTcp(const std::string& spec, int backlog) {
+        std::string host = "0.0.0.0";
+        std::string portStr = spec;
+        size_t colon = spec.rfind(':');
+        if (colon != std::string::npos) {
+            host = spec.substr(0, colon);
+            portStr = spec.substr(colon + 1);
+        }
+        struct sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(static_cast<uint16_t>(std::atoi(portStr.c_str())));
+        if (inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1) {
+            LOG_ERROR("Invalid listen address: %s", spec.c_str());
+            return false;
+        }
+
+        fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int opt = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+        if (bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0 || listen(fd, backlog) != 0) {
+            LOG_ERROR("Failed to listen on %s: %s", spec.c_str(), strerror(errno));
+            closeListener();
+            return false;
+        }
+        return true;
+    }
+
+    bool openUnix(std::string path, int backlog) {
+        mode_t mode = 0660;
+        size_t colon = path.rfind(':');
+        if (colon != std::string::npos && path.find('/', colon) == std::string::npos) {
+            mode = static_cast<mode_t>(std::strtoul(path.c_str() + colon + 1, nullptr, 8));
+            path.resize(colon);
+        }
+
+        struct sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+            LOG_ERROR("Invalid unix socket path: %s", path.c_str());
+            return false;
+        }
+        memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        if (!removeStaleSocket(path, address)) {
+            return false;
+        }
+
+        fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (bind(fd, (struct sockaddr*)&address, sizeof(address)) != 0) {
+            LOG_ERROR("Failed to bind unix socket %s: %s", path.c_str(), strerror(errno));
+            closeListener();
+            return false;
+        }
+        unixPath = path; // 从这里开始由本对象负责删除套接字文件
+        // 在 listen 之前设置权限，客户端不可能在权限生效前连上
+        if (chmod(path.c_str(), mode) != 0 || listen(fd, backlog) != 0) {
+            LOG_ERROR("Failed to listen on unix socket %s: %s", path.c_str(), strerror(errno));
+            closeListener();
+            return false;
+        }
+        return true;
+    }
+
+    // 上次进程异常退出会留下套接字文件，导致 bind 返回 EADDRINUSE。
+    // 只有确认没有进程在该路径上监听（connect 返回 ECONNREFUSED）时才删除它，
+    // 不是套接字的文件一律不动。
+    static bool removeStaleSocket(const std::string& path, const struct sockaddr_un& address) {
+        struct stat st;
+        if (lstat(path.c_str(), &st) != 0) {
+            return errno == ENOENT;
+        }
+        if (!S_ISSOCK(st.st_mode)) {
+            LOG_ERROR("%s exists and is not a socket", path.c_str());
+            return false;
+        }
+        int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        int ret = connect(probe, (const struct sockaddr*)&address, sizeof(address));
+        int err = errno;
+        close(probe);
+        if (ret == 0) {
+            LOG_ERROR("Unix socket %s is in use by another process", path.c_str());
+            return false;
+        }
+        if (err != ECONNREFUSED) {
+            LOG_ERROR("Cannot probe unix socket %s: %s", path.c_str(), strerror(err));
+            return false;
+        }
+        LOG_INFO("Removing stale unix socket %s", path.c_str());
+        return unlink(path.c_str()) == 0 || errno == ENOENT;
+    }
+
+    void closeListener() {
+        if (fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
+        if (!unixPath.empty()) {
+            unlink(unixPath.c_str());
+            unixPath.clear();
+        }
+    }
+
+    int fd = -1;
+    std::string unixPath; // AF_UNIX 端点的套接字文件，关闭时删除
+    std::string endpoint;
+};
@@ -0,0 +1,140 @@
+#pragma once
+#include "HttpResponse.h"
+#include "Hash.h"
+#include <chrono>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// ResponseCache 是进程内的 GET 响应微缓存，位于 Router 之前，只对显式开启缓存的路由生效。
+// 缓存按键分片以降低锁竞争，每个分片按 TTL 和总字节数限制大小。每个条目同时保存响应对象
+// 和它序列化后的 HTTP/1.1 报文：HTTP/1.1 连接命中时直接发送报文，HTTP/2 流则重新编码响应对象。
+// 同一个键并发未命中时只有第一个请求（leader）执行处理函数，其余请求登记为 waiter，
+// 等 leader 完成后直接拿到同一个响应，避免热点键过期瞬间把请求全部打到数据库上。
+class ResponseCache {
+public:
+    using Waiter = std::function<void(const HttpResponse&)>;
+
+    struct Cached {
+        HttpResponse response;
+        std::string wire; // response.toString()
+    };
+
+    enum class Lookup {
+        HIT,     // 命中缓存，cached 已填写
+        LEADER,  // 未命中，调用方负责执行处理函数并调用 complete()
+        WAITING  // 已有相同键的请求在执行，waiter 会在其完成时被调用
+    };
+
+    explicit ResponseCache(size_t maxBytes = 64 * 1024 * 1024, size_t maxEntryBytes = 1024 * 1024, size_t shardCount = 16)
+        : maxEntryBytes(maxEntryBytes), shards(shardCount) {
+        for (auto& shard : shards) {
+            shard.maxBytes = maxBytes / shardCount;
+        }
+    }
+
+    Lookup lookup(const std::string& key, std::shared_ptr<const Cached>& cached, Waiter waiter) {
+        Shard& shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.entries.find(key);
+        if (it != shard.entries.end()) {
+            if (std::chrono::steady_clock::now() < it->second.expires) {
+                shard.lru.splice(shard.lru.begin(), shard.lru, it->second.lruPos);
+                cached = it->second.data;
+                return Lookup::HIT;
+            }
+            shard.erase(it); // 已过期
+        }
+        auto inflight = shard.inflight.find(key);
+        if (inflight != shard.inflight.end()) {
+            inflight->second.push_back(std::move(waiter));
+            return Lookup::WAITING;
+        }
+        shard.inflight[key]; // 登记为正在执行，后续相同键的请求将等待
+        return Lookup::LEADER;
+    }
+
+    // 单个条目序列化后的大小上限，物化流式响应时读到这个大小就放弃缓存
+    size_t maxEntrySize() const {
+        return maxEntryBytes;
+    }
+
+    // leader 完成后调用：200 响应写入缓存，然后把响应交给所有等待者。
+    // 流式或文件响应需要调用方先物化，这里不会缓存它们；等待者拿到仍是流式的响应时需要自己重新执行处理函数。
+    void complete(const std::string& key, const HttpResponse& response, std::chrono::milliseconds ttl) {
+        std::shared_ptr<const Cached> data;
+        if (response.getStatusCode() == 200 && !response.isStreaming() && !response.getFileBody()) {
+            data = std::make_shared<const Cached>(Cached{response, response.toString()});
+        }
+
+        std::vector<Waiter> waiters;
+        Shard& shard = shardFor(key);
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            auto inflight = shard.inflight.find(key);
+            if (inflight != shard.inflight.end()) {
+                waiters.swap(inflight->second);
+                shard.inflight.erase(inflight);
+            }
+            if (data && data->wire.size() <= maxEntryBytes) {
+                shard.insert(key, data, std::chrono::steady_clock::now() + ttl);
+            }
+        }
+
+        // 在锁外回调，waiter 内部可能会获取其他锁
+        for (auto& waiter : waiters) {
+            waiter(response);
+        }
+    }
+
+private:
+    struct Entry {
+        std::shared_ptr<const Cached> data;
+        std::chrono::steady_clock::time_point expires;
+        std::list<std::string>::iterator lruPos;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<std::string, Entry> entries;
+        std::list<std::string> lru; // 头部为最近使用
+        std::unordered_map<std::string, std::vector<Waiter>> inflight;
+        size_t bytes = 0;
+        size_t maxBytes = 0;
+
+        void erase(std::unordered_map<std::string, Entry>::iterator it) {
+            bytes -= it->second.data->wire.size();
+            lru.erase(it->second.lruPos);
+            entries.erase(it);
+        }
+
+        void insert(const std::string& key, std::shared_ptr<const Cached> data,
+                    std::chrono::steady_clock::time_point expires) {
+            auto old = entries.find(key);
+            if (old != entries.end()) {
+                erase(old);
+            }
+            // 超出分片容量时淘汰最久未使用的条目
+            while (!lru.empty() && bytes + data->wire.size() > maxBytes) {
+                erase(entries.find(lru.back()));
+            }
+            if (data->wire.size() > maxBytes) {
+                return;
+            }
+            lru.push_front(key);
+            bytes += data->wire.size();
+            entries[key] = Entry{std::move(data), expires, lru.begin()};
+        }
+    };
+
+    Shard& shardFor(const std::string& key) {
+        return shards[XXHash64::hash(key.data(), key.size()) % shards.size()];
+    }
+
+    size_t maxEntryBytes;
+    std::vector<Shard> shards;
+};
@@ -1,8 +1,18 @@
+#pragma once
 #include "HttpRequest.h"
 #include "HttpResponse.h"
 #include "Database.h"
+#include "Executor.h"
+#include "Task.h"
+#include "FileCache.h"
+#include "ImageStore.h"
+#include "WritePipeline.h"
+#include "SessionToken.h"
+#include <charconv>
+#include <chrono>
 #include <functional>
 #include <unordered_map>
+#include <vector>
 #include <future>
 #include <sys/stat.h>  // 包含 mkdir 函数的声明
 #include <cerrno>      // 包含 errno 的声明
@@ -12,120 +22,389 @@ class Router {
 public:
     using HandlerFunc = std::function<HttpResponse(const HttpRequest&)>;
 
-    void addRoute(const std::string& method, const std::string& path, HandlerFunc handler) {
-        routes[method + "|" + path] = handler;
+    // exec 声明该路由在哪类执行器上运行，默认放到通用工作线程池
+    void addRoute(const std::string& method, const std::string& path, HandlerFunc handler,
+                  ExecClass exec = ExecClass::WORKER) {
+        routes[method + "|" + path] = Route{handler, exec, nullptr};
     }
 
-    HttpResponse routeRequest(const HttpRequest& request) {
+    // 为已注册的精确路由开启进程内响应缓存，只应用于幂等的 GET 路由。
+    // keyParams 列出影响响应的查询参数，缓存键只包含它们，其余查询参数不会产生新的缓存条目
+    void cacheRoute(const std::string& method, const std::string& path, std::chrono::milliseconds ttl,
+                    std::vector<std::string> keyParams = {}) {
+        auto it = routes.find(method + "|" + path);
+        if (it != routes.end()) {
+            it->second.cacheTtl = ttl;
+            it->second.cacheParams = std::move(keyParams);
+        }
+    }
+
+    // 缓存键：方法、路径和路由声明的查询参数
+    std::string getCacheKey(const HttpRequest& request) const {
         std::string key = request.getMethodString() + "|" + request.getPath();
-        LOG_WARNING("routeRequest: %s", key);
-        if (routes.count(key)) {
-            return routes[key](request);
+        const Route* route = findRoute(request);
+        if (route) {
+            for (const auto& name : route->cacheParams) {
+                key += "|" + name + "=" + std::string(request.getQueryParam(name));
+            }
+        }
+        return key;
+    }
+
+    // 返回请求对应路由的缓存有效期，0 表示不缓存
+    std::chrono::milliseconds getCacheTtl(const HttpRequest& request) const {
+        const Route* route = findRoute(request);
+        if (route && request.getMethodString() == "GET") {
+            return route->cacheTtl;
+        }
+        return std::chrono::milliseconds(0);
+    }
+
+    // 要求请求携带有效的会话令牌，校验失败时直接返回 401，不会执行处理函数
+    void requireSession(const std::string& method, const std::string& path) {
+        auto it = routes.find(method + "|" + path);
+        if (it != routes.end()) {
+            it->second.requireSession = true;
+        }
+    }
+
+    // 在内存中校验会话 Cookie；通过时把用户名写入请求，不需要会话的路由直接返回 true
+    bool authenticate(HttpRequest& request) {
+        const Route* route = findRoute(request);
+        if (!route || !route->requireSession) {
+            return true;
+        }
+        std::string user;
+        if (!sessions.verify(request.getCookie("session"), user)) {
+            return false;
+        }
+        request.setSessionUser(user);
+        return true;
+    }
+
+    // 前缀路由：路径以 prefix 开头的请求都交给该处理函数，精确匹配的路由优先
+    void addPrefixRoute(const std::string& method, const std::string& prefix, HandlerFunc handler,
+                        ExecClass exec = ExecClass::WORKER) {
+        prefixRoutes.push_back({method, prefix, Route{handler, exec, nullptr}});
+    }
+
+    // 协程处理函数：可以 co_await 数据库或文件操作，在 I/O 线程上启动并恢复
+    using AsyncHandlerFunc = std::function<Task<HttpResponse>(const HttpRequest&)>;
+
+    void addAsyncRoute(const std::string& method, const std::string& path, AsyncHandlerFunc handler) {
+        routes[method + "|" + path] = Route{nullptr, ExecClass::INLINE, handler};
+    }
+
+    // 返回请求对应的协程处理函数，普通路由返回 nullptr
+    const AsyncHandlerFunc* getAsyncHandler(const HttpRequest& request) const {
+        const Route* route = findRoute(request);
+        if (route && route->asyncHandler) {
+            return &route->asyncHandler;
+        }
+        return nullptr;
+    }
+
+    HttpResponse routeRequest(const HttpRequest& request) {
+        LOG_WARNING("routeRequest: %s|%s", request.getMethodString().c_str(), request.getPath().c_str());
+        const Route* route = findRoute(request);
+        if (route) {
+            return route->handler(request);
         }
         return HttpResponse::makeErrorResponse(404, "Not Found");
     }
 
+    // 查询请求应该派发到哪个执行器；未命中的路由直接在 I/O 线程上返回 404
+    ExecClass getExecClass(const HttpRequest& request) const {
+        const Route* route = findRoute(request);
+        if (route) {
+            return route->exec;
+        }
+        return ExecClass::INLINE;
+    }
+
     void setupDatabaseRoutes(Database& db) {
          // 注册路由
-        addRoute("POST", "/register", [&db](const HttpRequest& req) {
-            auto params = req.parseFormBody(); 
-            std::string username = params["username"];
-            std::string password = params["password"];
-            // 异步调用数据库注册方法
-            if (db.registerUser(username, password)) {
-                return HttpResponse::makeOkResponse("Register Success!");
+        addAsyncRoute("POST", "/register", [&db](const HttpRequest& req) -> Task<HttpResponse> {
+            const auto& params = req.parseFormBody();
+            std::string username(params.get("username"));
+            std::string password(params.get("password"));
+            // 协程等待数据库注册结果，等待期间不占用线程
+            if (co_await db.registerUserAsync(username, password)) {
+                co_return HttpResponse::makeOkResponse("Register Success!");
             } else {
-                return HttpResponse::makeErrorResponse(400, "Register Failed!");
+                co_return HttpResponse::makeErrorResponse(400, "Register Failed!");
             }
         });
 
         // 登录路由
-        addRoute("POST", "/login", [&db](const HttpRequest& req) {
-            auto params = req.parseFormBody();
-            std::string username = params["username"];
-            std::string password = params["password"];
-            // 异步调用数据库登录方法
-            if (db.loginUser(username, password)){
-                return HttpResponse::makeOkResponse("Login Success!");
+        addAsyncRoute("POST", "/login", [this, &db](const HttpRequest& req) -> Task<HttpResponse> {
+            const auto& params = req.parseFormBody();
+            std::string username(params.get("username"));
+            std::string password(params.get("password"));
+            // 协程等待数据库登录结果
+            if (co_await db.loginUserAsync(username, password)) {
+                // 签发会话令牌，之后的认证请求只需在内存中校验签名
+                const auto ttl = std::chrono::hours(24);
+                HttpResponse response = HttpResponse::makeOkResponse("Login Success!");
+                response.setHeader("Set-Cookie", "session=" + sessions.issue(username, ttl) +
+                                   "; Path=/; HttpOnly; SameSite=Lax; Max-Age=" + std::to_string(std::chrono::seconds(ttl).count()));
+                co_return response;
             } else {
-                return HttpResponse::makeErrorResponse(400, "Login Failed!");
+                co_return HttpResponse::makeErrorResponse(400, "Login Failed!");
             }
         });
+
+        // 当前会话信息：只校验令牌，不访问数据库
+        addRoute("GET", "/session", [](const HttpRequest& req) {
+            return HttpResponse::makeOkResponse(req.getSessionUser());
+        }, ExecClass::INLINE);
+        requireSession("GET", "/session");
     }
 
-void setupImageRoutes(Database& db) {
+void setupImageRoutes(Database& db, Executors& executors) {
         // 图片上传路由
-       addRoute("POST", "/upload", [&db](const HttpRequest& req) {
+       // 上传流程：工作线程计算哈希并去重 -> 写入流水线组提交落盘 -> 数据库记录，全程不占用阻塞线程
+       addAsyncRoute("POST", "/upload", [this, &db, &executors](const HttpRequest& req) -> Task<HttpResponse> {
         // 获取表单字段
-        std::string fileContent = req.getFileContent("file");
+        auto fileContent = std::make_shared<const std::string>(req.getFileContent("file"));
         std::string fileName = req.getFileName("file");  // 使用新方法获取文件名
         std::string description = req.getFormField("description");
 
-        // 检查并创建目录
-        std::string dirPath = "images/";
-        try {
-            if (mkdir(dirPath.c_str(), 0777) == -1 && errno != EEXIST) {
-                LOG_ERROR("Failed to create directory: %s", dirPath.c_str());
-                return HttpResponse::makeErrorResponse(500, "Internal Server Error: Unable to create directory");
+        // 按内容哈希定位文件，相同内容只在磁盘上保存一份，不会因同名上传互相覆盖
+        auto locate = offload(executors.worker(), [this, fileContent, fileName]() {
+            ImageStore::Blob blob;
+            return imageStore.locate(*fileContent, fileName, blob) ? std::optional<ImageStore::Blob>(blob) : std::nullopt;
+        });
+        std::optional<ImageStore::Blob> located = co_await locate;
+        if (!located) {
+            co_return HttpResponse::makeErrorResponse(500, "Internal Server Error: Unable to save file");
+        }
+        ImageStore::Blob blob = *located;
+
+        // 增加 blob 的引用计数。去重命中的文件可能在此之前被并发的释放删除，此时重新写入
+        for (int attempt = 0;; ++attempt) {
+            // 数据 fdatasync 并 rename 到位之后才继续，保证响应成功时文件已经持久化
+            if (blob.needsWrite) {
+                if (!co_await writePipeline.write(blob.path, fileContent)) {
+                    co_return HttpResponse::makeErrorResponse(500, "Internal Server Error: Unable to save file");
+                }
+                LOG_INFO("File saved successfully: %s", blob.path.c_str());
+            } else {
+                LOG_INFO("File deduplicated: %s", blob.path.c_str());
             }
-        } catch (const std::exception& e) {
-            LOG_ERROR("Exception while creating directory: %s, error: %s", dirPath.c_str(), e.what());
-            return HttpResponse::makeErrorResponse(500, "Internal Server Error: Exception while creating directory");
-        }
-
-        // 保存文件到服务器的某个路径
-        std::string filePath = dirPath + fileName;
-        try {
-            std::ofstream file(filePath, std::ios::binary);
-            if (!file.is_open()) {
-                LOG_ERROR("Failed to open file for writing: %s", filePath.c_str());
-                return HttpResponse::makeErrorResponse(500, "Internal Server Error: Unable to save file");
+            auto acquire = offload(executors.blocking(), [this, &db, key = blob.key]() {
+                return acquireStoredBlob(db, key);
+            });
+            BlobRef ref = co_await acquire;
+            if (ref == BlobRef::ACQUIRED) {
+                break;
             }
-            file.write(fileContent.c_str(), fileContent.size());
-            file.close();
-            LOG_INFO("File saved successfully: %s", filePath.c_str());
-        } catch (const std::exception& e) {
-            LOG_ERROR("Exception while saving file: %s, error: %s", filePath.c_str(), e.what());
-            return HttpResponse::makeErrorResponse(500, "Internal Server Error: Exception while saving file");
-        }
-
-        // 将图片信息存入数据库
-        try {
-            if (!db.storeImage(fileName, filePath, description)) {
-                LOG_ERROR("Failed to store image info in database for: %s", fileName.c_str());
-                return HttpResponse::makeErrorResponse(500, "Internal Server Error: Unable to store image info");
+            if (ref == BlobRef::FAILED || attempt == 2) {
+                LOG_ERROR("Failed to acquire image blob: %s", blob.key.c_str());
+                co_return HttpResponse::makeErrorResponse(500, "Internal Server Error: Unable to store image info");
             }
-        } catch (const std::exception& e) {
-            LOG_ERROR("Exception while storing image info in database for: %s, error: %s", fileName.c_str(), e.what());
-            return HttpResponse::makeErrorResponse(500, "Internal Server Error: Exception while storing image info");
+            blob.needsWrite = true;
+        }
+
+        // 将图片信息存入数据库。记录与列表中的 path 是下载地址（与旧的 images/<name> 记录形式相同），不是磁盘上的分片路径
+        if (!co_await db.storeImageAsync(fileName, "images/" + blob.key, description, blob.key)) {
+            LOG_ERROR("Failed to store image info in database for: %s", fileName.c_str());
+            auto release = offload(executors.blocking(), [this, &db, key = blob.key]() {
+                releaseStoredBlob(db, key);
+                return true;
+            });
+            co_await release;
+            co_return HttpResponse::makeErrorResponse(500, "Internal Server Error: Unable to store image info");
         }
 
         LOG_INFO("Image uploaded successfully: %s", fileName.c_str());
-        return HttpResponse::makeOkResponse("Image uploaded successfully");
+        co_return HttpResponse::makeOkResponse("Image uploaded successfully");
     });
 
 
-        // 获取图片列表路由
-        addRoute("GET", "/images", [&db](const HttpRequest& req) {
-            std::vector<std::string> imageList = db.getImageList();
-            std::stringstream ss;
-            ss << "[";
-            for (size_t i = 0; i < imageList.size(); ++i) {
-                ss << "\"" << imageList[i] << "\"";
-                if (i < imageList.size() - 1) {
-                    ss << ", ";
+        // 图片下载路由：GET /images/<name>，通过 sendfile 发送并支持 Range 请求
+        addPrefixRoute("GET", "/images/", [this](const HttpRequest& req) {
+            std::string name = req.getPath().substr(8);
+            if (name.empty() || name.find('/') != std::string::npos || name.find("..") != std::string::npos) {
+                return HttpResponse::makeErrorResponse(404, "Not Found");
+            }
+            // 内容键映射到分片目录，其他文件名按旧的 images/<name> 布局查找
+            auto file = fileCache.open(ImageStore::isKey(name) ? imageStore.pathFor(name) : "images/" + name);
+            if (!file) {
+                return HttpResponse::makeErrorResponse(404, "Not Found");
+            }
+
+            off_t size = file->st.st_size;
+            HttpResponse response;
+            response.setHeader("Content-Type", HttpResponse::getMimeType(name));
+            response.setHeader("Accept-Ranges", "bytes");
+
+            std::string range = req.getHeader("Range");
+            off_t start = 0, end = size - 1;
+            bool ignored = true;
+            if (!range.empty()) {
+                if (parseRange(range, size, start, end, ignored)) {
+                    response.setStatusCode(206);
+                    response.setHeader("Content-Range", "bytes " + std::to_string(start) + "-" +
+                                       std::to_string(end) + "/" + std::to_string(size));
+                    response.setFileBody(file, start, end - start + 1);
+                    return response;
+                }
+                if (!ignored) {
+                    response.setStatusCode(416);
+                    response.setHeader("Content-Range", "bytes */" + std::to_string(size));
+                    return response;
                 }
             }
-            ss << "]";
+            response.setStatusCode(200);
+            response.setFileBody(file, 0, size);
+            return response;
+        });
 
+        // 获取图片列表路由：边读数据库游标边以 chunked 编码输出 JSON，不在内存中拼出整个列表。
+        // 可选的 ?limit=N 限制返回的条目数
+        addRoute("GET", "/images", [&db](const HttpRequest& req) {
+            size_t limit = SIZE_MAX;
+            std::string_view limitParam = req.getQueryParam("limit");
+            if (!limitParam.empty()) {
+                // 只接受十进制非负整数，"-1"、"abc"、溢出都返回 400
+                auto end = limitParam.data() + limitParam.size();
+                auto [ptr, ec] = std::from_chars(limitParam.data(), end, limit);
+                if (ec != std::errc() || ptr != end) {
+                    return HttpResponse::makeErrorResponse(400, "Invalid limit");
+                }
+            }
+            auto next = db.openImagePathStream(limit); // 数量限制下推到查询，游标不会多取
+            auto first = std::make_shared<bool>(true);
+            auto remaining = std::make_shared<size_t>(limit);
             HttpResponse response;
             response.setStatusCode(200);
             response.setHeader("Content-Type", "application/json");
-            response.setBody(ss.str());
+            response.setStreamingBody([next, first, remaining](std::string& chunk) {
+                const size_t batch = 64; // 每块最多输出的条目数，避免块过小
+                if (*first) {
+                    chunk += "[";
+                }
+                std::string path;
+                for (size_t i = 0; i < batch; ++i) {
+                    if (*remaining == 0 || !next(path)) {
+                        chunk += "]";
+                        return false;
+                    }
+                    if (!*first) {
+                        chunk += ", ";
+                    }
+                    *first = false;
+                    --*remaining;
+                    chunk += "\"" + path + "\"";
+                }
+                return true;
+            }, ExecClass::BLOCKING);
             return response;
-        });
+        }, ExecClass::INLINE);
+        // 图片列表读多写少，短时间缓存即可挡住对 MongoDB 的突发读取
+        cacheRoute("GET", "/images", std::chrono::seconds(2), {"limit"});
     }
 
 private:
-    std::unordered_map<std::string, HandlerFunc> routes;
+    struct Route {
+        HandlerFunc handler;
+        ExecClass exec;
+        AsyncHandlerFunc asyncHandler;
+        std::chrono::milliseconds cacheTtl{0};
+        std::vector<std::string> cacheParams; // 参与缓存键的查询参数
+        bool requireSession = false;
+    };
+
+    struct PrefixRoute {
+        std::string method;
+        std::string prefix;
+        Route route;
+    };
+
+    const Route* findRoute(const HttpRequest& request) const {
+        std::string method = request.getMethodString();
+        auto it = routes.find(method + "|" + request.getPath());
+        if (it != routes.end()) {
+            return &it->second;
+        }
+        for (const auto& prefixRoute : prefixRoutes) {
+            if (prefixRoute.method == method && request.getPath().compare(0, prefixRoute.prefix.size(), prefixRoute.prefix) == 0) {
+                return &prefixRoute.route;
+            }
+        }
+        return nullptr;
+    }
+
+    // 解析 "bytes=start-end" 形式的单个区间，成功时返回 true 并填写 [start, end]。
+    // 不支持的格式（例如多个区间）通过 ignored 告知调用方按完整内容返回。
+    static bool parseRange(const std::string& header, off_t size, off_t& start, off_t& end, bool& ignored) {
+        ignored = false;
+        if (header.compare(0, 6, "bytes=") != 0 || header.find(',') != std::string::npos) {
+            ignored = true;
+            return false;
+        }
+        std::string spec = header.substr(6);
+        size_t dash = spec.find('-');
+        if (dash == std::string::npos) {
+            ignored = true;
+            return false;
+        }
+        std::string first = spec.substr(0, dash);
+        std::string last = spec.substr(dash + 1);
+        char* endp = nullptr;
+        if (first.empty()) {
+            // 后缀区间 "bytes=-N"：最后 N 个字节
+            if (last.empty()) { ignored = true; return false; }
+            off_t suffix = std::strtoll(last.c_str(), &endp, 10);
+            if (*endp != '\0') { ignored = true; return false; }
+            if (suffix <= 0 || size == 0) return false;
+            start = suffix >= size ? 0 : size - suffix;
+            end = size - 1;
+            return true;
+        }
+        start = std::strtoll(first.c_str(), &endp, 10);
+        if (*endp != '\0') { ignored = true; return false; }
+        if (last.empty()) {
+            end = size - 1;
+        } else {
+            end = std::strtoll(last.c_str(), &endp, 10);
+            if (*endp != '\0' || end < start) { ignored = true; return false; }
+            if (end >= size) end = size - 1;
+        }
+        return start < size;
+    }
+
+    enum class BlobRef { ACQUIRED, MISSING, FAILED };
+
+    // 文件仍在时增加引用计数；文件已被并发的释放删除时返回 MISSING，由调用方重新写入。
+    // 与 releaseStoredBlob 在同一把分段锁下执行。阻塞调用，应在 BLOCKING 线程池中运行
+    BlobRef acquireStoredBlob(Database& db, const std::string& key) {
+        std::lock_guard<std::mutex> lock(imageStore.lockFor(key));
+        if (!imageStore.exists(key)) {
+            return BlobRef::MISSING;
+        }
+        return db.acquireBlob(key) ? BlobRef::ACQUIRED : BlobRef::FAILED;
+    }
+
+    // 引用计数减一，只有最后一个引用被删除时才删除文件
+    void releaseStoredBlob(Database& db, const std::string& key) {
+        std::lock_guard<std::mutex> lock(imageStore.lockFor(key));
+        if (db.releaseBlob(key)) {
+            removeBlob(key);
+        }
+    }
+
+    // 删除 blob 文件，同时丢弃 fd 缓存中的条目，否则下载路由还会从缓存的 fd 发送已删除的文件
+    void removeBlob(const std::string& key) {
+        imageStore.remove(key);
+        fileCache.invalidate(imageStore.pathFor(key));
+    }
+
+    std::unordered_map<std::string, Route> routes;
+    std::vector<PrefixRoute> prefixRoutes;
+    FileCache fileCache; // 图片下载使用的 fd 缓存
+    ImageStore imageStore; // 按内容寻址的图片存储
+    WritePipeline writePipeline; // 上传文件的异步落盘流水线
+    SessionManager sessions; // 会话令牌的签发与校验
 };
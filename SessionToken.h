@@ -0,0 +1,167 @@
+#pragma once
+#include "Logger.h"
+#include <openssl/crypto.h>
+#include <openssl/evp.h>
+#include <openssl/hmac.h>
+#include <openssl/rand.h>
+#include <chrono>
+#include <cstdlib>
+#include <mutex>
+#include <shared_mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+// SessionManager 签发和校验无状态的会话令牌，校验完全在内存中完成，不需要查询数据库。
+// 令牌格式：base64url("<keyId>|<过期时间戳>|<用户名>") + "." + base64url(HMAC-SHA256)
+// 支持密钥轮换：新令牌总是用当前密钥签名，旧密钥在移除之前仍可用于校验。
+class SessionManager {
+public:
+    // 从环境变量 SESSION_KEYS 读取密钥，格式为 "kid1:secret1,kid2:secret2"，第一个为当前签名密钥。
+    // 未配置时生成随机密钥，进程重启后之前签发的令牌全部失效；无法生成随机密钥时抛出 std::runtime_error。
+    SessionManager() {
+        const char* env = std::getenv("SESSION_KEYS");
+        if (env && *env) {
+            std::istringstream iss(env);
+            std::string item;
+            while (std::getline(iss, item, ',')) {
+                size_t colon = item.find(':');
+                if (colon == std::string::npos || colon == 0) continue;
+                addKey(item.substr(0, colon), item.substr(colon + 1));
+                if (currentKeyId.empty()) currentKeyId = item.substr(0, colon);
+            }
+        }
+        if (currentKeyId.empty()) {
+            // 随机数生成失败时不能退回未初始化的缓冲区，否则签名密钥可以被猜出，启动直接失败
+            unsigned char secret[32];
+            if (RAND_bytes(secret, sizeof(secret)) != 1) {
+                LOG_ERROR("Failed to generate a random session key");
+                throw std::runtime_error("RAND_bytes failed");
+            }
+            addKey("0", std::string(reinterpret_cast<char*>(secret), sizeof(secret)));
+            currentKeyId = "0";
+            LOG_WARNING("SESSION_KEYS not set, using a random session key");
+        }
+    }
+
+    void addKey(const std::string& keyId, const std::string& secret) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        keys[keyId] = secret;
+    }
+
+    // 切换签名密钥，旧密钥保留用于校验尚未过期的令牌
+    bool setCurrentKey(const std::string& keyId) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        if (keys.count(keyId) == 0) return false;
+        currentKeyId = keyId;
+        return true;
+    }
+
+    void removeKey(const std::string& keyId) {
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        if (keyId != currentKeyId) keys.erase(keyId);
+    }
+
+    std::string issue(const std::string& username, std::chrono::seconds ttl) {
+        long long expires = std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch() + ttl).count();
+        // 共享锁下不能用 operator[]（可能插入）；当前密钥不会被 removeKey 删除，at 总能找到
+        std::shared_lock<std::shared_mutex> lock(mutex);
+        std::string payload = currentKeyId + "|" + std::to_string(expires) + "|" + username;
+        return base64UrlEncode(payload) + "." + base64UrlEncode(sign(keys.at(currentKeyId), payload));
+    }
+
+    // 校验签名和有效期，成功时返回 true 并填写用户名
+    bool verify(const std::string& token, std::string& username) {
+        size_t dot = token.find('.');
+        if (dot == std::string::npos) return false;
+        std::string payload, mac;
+        if (!base64UrlDecode(token.substr(0, dot), payload) || !base64UrlDecode(token.substr(dot + 1), mac)) {
+            return false;
+        }
+
+        size_t first = payload.find('|');
+        size_t second = first == std::string::npos ? std::string::npos : payload.find('|', first + 1);
+        if (second == std::string::npos) return false;
+        std::string keyId = payload.substr(0, first);
+
+        std::string expected;
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex);
+            auto it = keys.find(keyId);
+            if (it == keys.end()) return false;
+            expected = sign(it->second, payload);
+        }
+        // 常量时间比较，避免通过响应时间推测签名
+        if (mac.size() != expected.size() || CRYPTO_memcmp(mac.data(), expected.data(), mac.size()) != 0) {
+            return false;
+        }
+
+        long long expires = std::strtoll(payload.c_str() + first + 1, nullptr, 10);
+        long long now = std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        if (now >= expires) return false;
+
+        username = payload.substr(second + 1);
+        return true;
+    }
+
+private:
+    static std::string sign(const std::string& secret, const std::string& payload) {
+        unsigned char mac[EVP_MAX_MD_SIZE];
+        unsigned int macLen = 0;
+        HMAC(EVP_sha256(), secret.data(), static_cast<int>(secret.size()),
+             reinterpret_cast<const unsigned char*>(payload.data()), payload.size(), mac, &macLen);
+        return std::string(reinterpret_cast<char*>(mac), macLen);
+    }
+
+    static std::string base64UrlEncode(const std::string& in) {
+        static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_";
+        std::string out;
+        out.reserve((in.size() + 2) / 3 * 4);
+        size_t i = 0;
+        for (; i + 2 < in.size(); i += 3) {
+            unsigned v = (static_cast<unsigned char>(in[i]) << 16) | (static_cast<unsigned char>(in[i + 1]) << 8) |
+                         static_cast<unsigned char>(in[i + 2]);
+            out += table[(v >> 18) & 63];
+            out += table[(v >> 12) & 63];
+            out += table[(v >> 6) & 63];
+            out += table[v & 63];
+        }
+        if (i < in.size()) {
+            unsigned v = static_cast<unsigned char>(in[i]) << 16;
+            if (i + 1 < in.size()) v |= static_cast<unsigned char>(in[i + 1]) << 8;
+            out += table[(v >> 18) & 63];
+            out += table[(v >> 12) & 63];
+            if (i + 1 < in.size()) out += table[(v >> 6) & 63];
+        }
+        return out;
+    }
+
+    static bool base64UrlDecode(const std::string& in, std::string& out) {
+        out.clear();
+        unsigned v = 0;
+        int bits = 0;
+        for (char c : in) {
+            int d;
+            if (c >= 'A' && c <= 'Z') d = c - 'A';
+            else if (c >= 'a' && c <= 'z') d = c - 'a' + 26;
+            else if (c >= '0' && c <= '9') d = c - '0' + 52;
+            else if (c == '-') d = 62;
+            else if (c == '_') d = 63;
+            else return false;
+            v = (v << 6) | d;
+            bits += 6;
+            if (bits >= 8) {
+                bits -= 8;
+                out += static_cast<char>((v >> bits) & 0xFF);
+            }
+        }
+        return true;
+    }
+
+    std::unordered_map<std::string, std::string> keys; // keyId -> 密钥
+    std::string currentKeyId;
+    std::shared_mutex mutex;
+};
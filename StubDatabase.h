@@ -0,0 +1,132 @@
+#pragma once
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "Logger.h"
+#include "ThreadPool.h"
+#include "Task.h"
+
+// 与 Database.h 接口相同的内存实现，不需要 MongoDB。由 Database.h 在定义了 HTTPSERVER_STUB_DATABASE 时引入。
+// 调用同样在 driverPool 中执行，并可以模拟驱动的往返延迟，让线程占用和排队情况接近真实部署：
+//     mongo_uri=stub://?latency_us=500
+// 数据只保存在进程内存中，重启后清空。
+class Database {
+private:
+    ThreadPool driverPool;
+    std::chrono::microseconds latency{0};
+    std::mutex mutex; // 保护下面的数据，模拟的延迟不在锁内
+    std::unordered_map<std::string, std::string> users;
+    std::vector<std::string> imagePaths;
+    std::unordered_map<std::string, int> blobRefs;
+
+    void simulateLatency() const {
+        if (latency.count() > 0) {
+            std::this_thread::sleep_for(latency);
+        }
+    }
+
+public:
+    Database(const std::string& uri, size_t driverThreads = 4) : driverPool(driverThreads) {
+        size_t pos = uri.find("latency_us=");
+        if (pos != std::string::npos) {
+            latency = std::chrono::microseconds(std::strtol(uri.c_str() + pos + 11, nullptr, 10));
+        }
+        LOG_INFO("Using in-memory stub database, latency %ld us", static_cast<long>(latency.count()));
+    }
+
+    Task<bool> registerUserAsync(std::string username, std::string password) {
+        auto call = offload(driverPool, [this, username, password]() {
+            return this->registerUser(username, password);
+        });
+        co_return co_await call;
+    }
+
+    Task<bool> loginUserAsync(std::string username, std::string password) {
+        auto call = offload(driverPool, [this, username, password]() {
+            return this->loginUser(username, password);
+        });
+        co_return co_await call;
+    }
+
+    bool registerUser(const std::string& username, const std::string& password) {
+        simulateLatency();
+        std::lock_guard<std::mutex> lock(mutex);
+        users[username] = password; // 与 MongoDB 版本一样不检查重名
+        return true;
+    }
+
+    bool loginUser(const std::string& username, const std::string& password) {
+        simulateLatency();
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = users.find(username);
+        return it != users.end() && it->second == password;
+    }
+
+    bool storeImage(const std::string&, const std::string& imagePath, const std::string&, const std::string& = "") {
+        simulateLatency();
+        std::lock_guard<std::mutex> lock(mutex);
+        imagePaths.push_back(imagePath);
+        return true;
+    }
+
+    bool acquireBlob(const std::string& key) {
+        simulateLatency();
+        std::lock_guard<std::mutex> lock(mutex);
+        ++blobRefs[key];
+        return true;
+    }
+
+    bool releaseBlob(const std::string& key) {
+        simulateLatency();
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = blobRefs.find(key);
+        if (it == blobRefs.end() || --it->second > 0) {
+            return false;
+        }
+        blobRefs.erase(it);
+        return true;
+    }
+
+    std::vector<std::string> getImageList() {
+        simulateLatency();
+        std::lock_guard<std::mutex> lock(mutex);
+        return imagePaths;
+    }
+
+    Task<bool> storeImageAsync(std::string imageName, std::string imagePath, std::string description, std::string hash) {
+        auto call = offload(driverPool, [=, this]() {
+            return this->storeImage(imageName, imagePath, description, hash);
+        });
+        co_return co_await call;
+    }
+
+    // 第一次调用时取快照（相当于发出查询），之后逐条返回；limit 与 Database 相同
+    std::function<bool(std::string&)> openImagePathStream(size_t limit = SIZE_MAX) {
+        struct State {
+            bool started = false;
+            std::vector<std::string> paths;
+            size_t next = 0;
+        };
+        auto state = std::make_shared<State>();
+        return [this, state, limit](std::string& path) {
+            if (!state->started) {
+                state->paths = getImageList();
+                if (state->paths.size() > limit) {
+                    state->paths.resize(limit);
+                }
+                state->started = true;
+            }
+            if (state->next == state->paths.size()) {
+                return false;
+            }
+            path = state->paths[state->next++];
+            return true;
+        };
+    }
+};
@@ -0,0 +1,169 @@
+#pragma once
+#include "ThreadPool.h"
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+
+// ResumeExecutor 表示协程“所属”的事件循环。
+// 阻塞调用在线程池中完成后，通过 post 把协程的恢复投递回原来的 I/O 线程。
+class ResumeExecutor {
+public:
+    virtual ~ResumeExecutor() = default;
+    virtual void post(std::function<void()> fn) = 0;
+
+    // 当前线程正在运行的事件循环，非 I/O 线程上为 nullptr
+    static ResumeExecutor*& current() {
+        static thread_local ResumeExecutor* executor = nullptr;
+        return executor;
+    }
+};
+
+// Task<T> 是惰性启动的协程返回类型，处理函数可以写成
+//     Task<HttpResponse> handler(const HttpRequest& req) { bool ok = co_await db.loginUserAsync(...); ... }
+// 既可以被另一个 Task co_await，也可以通过 start() 以分离方式运行并在完成时回调。
+// 目前只需要带返回值的任务，因此没有提供 Task<void> 特化。
+template<class T>
+class Task {
+public:
+    struct promise_type {
+        std::optional<T> value;
+        std::exception_ptr error;
+        std::coroutine_handle<> continuation;
+        bool detached = false;
+        std::function<void(T)> onDone;
+        std::function<void(std::exception_ptr)> onError;
+
+        Task get_return_object() {
+            return Task(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+
+        struct FinalAwaiter {
+            bool await_ready() noexcept { return false; }
+
+            std::coroutine_handle<> await_suspend(std::coroutine_handle<promise_type> h) noexcept {
+                auto& p = h.promise();
+                if (p.continuation) {
+                    return p.continuation; // 对称转移，直接恢复等待者
+                }
+                if (p.detached) {
+                    // 分离运行的任务在这里交付结果并释放协程帧
+                    if (p.error) {
+                        if (p.onError) p.onError(p.error);
+                    } else if (p.onDone) {
+                        p.onDone(std::move(*p.value));
+                    }
+                    h.destroy();
+                }
+                return std::noop_coroutine();
+            }
+
+            void await_resume() noexcept {}
+        };
+
+        FinalAwaiter final_suspend() noexcept { return {}; }
+
+        template<class U>
+        void return_value(U&& v) {
+            value.emplace(std::forward<U>(v));
+        }
+
+        void unhandled_exception() {
+            error = std::current_exception();
+        }
+    };
+
+    Task(Task&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    ~Task() {
+        if (handle) handle.destroy();
+    }
+
+    // 被另一个协程 co_await 时，启动本任务并在结束后恢复等待者
+    bool await_ready() const noexcept { return false; }
+
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle.promise().continuation = awaiting;
+        return handle;
+    }
+
+    T await_resume() {
+        auto& p = handle.promise();
+        if (p.error) std::rethrow_exception(p.error);
+        return std::move(*p.value);
+    }
+
+    // 分离运行：协程帧自行管理生命周期，完成时在最后恢复它的线程上调用回调
+    void start(std::function<void(T)> onDone, std::function<void(std::exception_ptr)> onError = {}) {
+        auto h = std::exchange(handle, {});
+        h.promise().detached = true;
+        h.promise().onDone = std::move(onDone);
+        h.promise().onError = std::move(onError);
+        h.resume();
+    }
+
+private:
+    explicit Task(std::coroutine_handle<promise_type> h) : handle(h) {}
+
+    std::coroutine_handle<promise_type> handle;
+};
+
+// BlockingCall 把一次阻塞调用（数据库驱动、磁盘 I/O）放到指定线程池执行，
+// 完成后在协程所属的事件循环上恢复；挂起期间不占用任何线程。
+template<class F>
+class BlockingCall {
+public:
+    using Result = decltype(std::declval<F&>()());
+
+    BlockingCall(ThreadPool& pool, F fn) : pool(pool), fn(std::move(fn)) {}
+
+    bool await_ready() const noexcept { return false; }
+
+    bool await_suspend(std::coroutine_handle<> h) {
+        ResumeExecutor* owner = ResumeExecutor::current();
+        bool accepted = pool.tryEnqueue([this, h, owner]() {
+            try {
+                result.emplace(fn());
+            } catch (...) {
+                error = std::current_exception();
+            }
+            if (owner) {
+                owner->post([h]() { h.resume(); });
+            } else {
+                h.resume();
+            }
+        });
+        if (!accepted) {
+            // 线程池队列已满：不挂起，直接把错误抛给协程
+            error = std::make_exception_ptr(std::runtime_error("blocking pool queue full"));
+            return false;
+        }
+        return true;
+    }
+
+    Result await_resume() {
+        if (error) std::rethrow_exception(error);
+        return std::move(*result);
+    }
+
+private:
+    ThreadPool& pool;
+    F fn;
+    std::optional<Result> result;
+    std::exception_ptr error;
+};
+
+// 注意：GCC 12 会重复析构直接写在 co_await 表达式里的 lambda 的捕获（例如捕获的 std::string），
+// 因此先把 offload 的结果保存为具名变量再 co_await：
+//     auto call = offload(pool, [s]() { ... });
+//     auto result = co_await call;
+template<class F>
+BlockingCall<F> offload(ThreadPool& pool, F fn) {
+    return BlockingCall<F>(pool, std::move(fn));
+}
@@ -0,0 +1,233 @@
+#pragma once
+#include "Logger.h"
+#include <openssl/bio.h>
+#include <openssl/err.h>
+#include <openssl/ssl.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <sstream>
+#include <string>
+
+// TlsContext 是进程内 TLS 终止的配置：证书、会话恢复和内核 TLS（kTLS）。
+// 开启 SSL_OP_ENABLE_KTLS 后，握手完成时 OpenSSL 会对套接字设置 TCP_ULP "tls"，
+// 把对称加密交给内核，之后 SSL_sendfile 可以直接从页缓存发送文件而不经过用户态。
+// 内核或密码套件不支持 kTLS 时自动退回用户态加密，功能不受影响。
+class TlsContext {
+public:
+    TlsContext() = default;
+    TlsContext(const TlsContext&) = delete;
+    TlsContext& operator=(const TlsContext&) = delete;
+
+    ~TlsContext() {
+        if (ctx) SSL_CTX_free(ctx);
+    }
+
+    bool init(const std::string& certFile, const std::string& keyFile) {
+        ctx = SSL_CTX_new(TLS_server_method());
+        if (!ctx) {
+            logErrors("SSL_CTX_new failed");
+            return false;
+        }
+        SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+        // 部分写入模式：SSL_write 与非阻塞 send 一样可以只写出一部分
+        SSL_CTX_set_mode(ctx, SSL_MODE_ENABLE_PARTIAL_WRITE | SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
+        SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS | SSL_OP_CIPHER_SERVER_PREFERENCE | SSL_OP_NO_RENEGOTIATION |
+                                 SSL_OP_IGNORE_UNEXPECTED_EOF);
+        // kTLS 只支持 AES-GCM / ChaCha20-Poly1305，优先选择内核能接管的套件
+        SSL_CTX_set_cipher_list(ctx, "ECDHE+AESGCM:ECDHE+CHACHA20");
+
+        if (SSL_CTX_use_certificate_chain_file(ctx, certFile.c_str()) != 1 ||
+            SSL_CTX_use_PrivateKey_file(ctx, keyFile.c_str(), SSL_FILETYPE_PEM) != 1 ||
+            SSL_CTX_check_private_key(ctx) != 1) {
+            logErrors("Failed to load TLS certificate or key");
+            return false;
+        }
+
+        // 会话恢复：TLS 1.2 的服务端会话缓存，以及默认开启的会话票据（TLS 1.2/1.3 都适用）。
+        // 票据密钥由 OpenSSL 在进程启动时随机生成，重启后客户端回退到完整握手。
+        static const unsigned char sessionContext[] = "httpserver";
+        SSL_CTX_set_session_id_context(ctx, sessionContext, sizeof(sessionContext) - 1);
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER);
+        SSL_CTX_sess_set_cache_size(ctx, 20480);
+        SSL_CTX_set_timeout(ctx, 3600);
+        SSL_CTX_set_num_tickets(ctx, 1);
+
+        // ALPN：优先协商 h2，连接随后以 HTTP/2 连接前言开始，由服务器按前言识别
+        SSL_CTX_set_alpn_select_cb(ctx, selectAlpn, nullptr);
+        return true;
+    }
+
+    SSL* newSession(int fd) {
+        SSL* ssl = SSL_new(ctx);
+        if (ssl) {
+            SSL_set_fd(ssl, fd);
+            SSL_set_accept_state(ssl);
+        }
+        return ssl;
+    }
+
+    // 握手和 kTLS 的统计，输出到 /metrics
+    std::atomic<uint64_t> handshakes{0};
+    std::atomic<uint64_t> resumed{0};
+    std::atomic<uint64_t> ktlsSend{0};
+    std::atomic<uint64_t> handshakeFailures{0};
+
+    std::string statsString() const {
+        std::ostringstream oss;
+        oss << "tls_handshakes " << handshakes.load() << "\n"
+            << "tls_resumed " << resumed.load() << "\n"
+            << "tls_ktls_send " << ktlsSend.load() << "\n"
+            << "tls_handshake_failures " << handshakeFailures.load() << "\n";
+        return oss.str();
+    }
+
+    static void logErrors(const char* what) {
+        unsigned long err = ERR_get_error();
+        char buf[256];
+        ERR_error_string_n(err, buf, sizeof(buf));
+        LOG_ERROR("%s: %s", what, err ? buf : "unknown error");
+        ERR_clear_error();
+    }
+
+private:
+    static int selectAlpn(SSL*, const unsigned char** out, unsigned char* outlen,
+                          const unsigned char* in, unsigned int inlen, void*) {
+        static const unsigned char protos[] = "\x02h2\x08http/1.1";
+        unsigned char* selected = nullptr;
+        if (SSL_select_next_proto(&selected, outlen, protos, sizeof(protos) - 1, in, inlen) != OPENSSL_NPN_NEGOTIATED) {
+            return SSL_TLSEXT_ERR_NOACK;
+        }
+        *out = selected;
+        return SSL_TLSEXT_ERR_OK;
+    }
+
+    SSL_CTX* ctx = nullptr;
+};
+
+// TlsStream 是单个连接上的 TLS 状态，接口与非阻塞套接字调用保持一致：
+// 返回 -1 且 errno 为 EAGAIN 表示需要等待套接字就绪，0 表示对端关闭。
+class TlsStream {
+public:
+    enum class Handshake { DONE, WANT_READ, WANT_WRITE, FAILED };
+
+    TlsStream(TlsContext& context, int fd) : context(context), ssl(context.newSession(fd)) {}
+    TlsStream(const TlsStream&) = delete;
+    TlsStream& operator=(const TlsStream&) = delete;
+
+    ~TlsStream() {
+        if (ssl) SSL_free(ssl);
+    }
+
+    bool isEstablished() const {
+        return established;
+    }
+
+    Handshake handshake() {
+        if (established) {
+            return Handshake::DONE;
+        }
+        if (!ssl) {
+            return Handshake::FAILED;
+        }
+        int ret = SSL_do_handshake(ssl);
+        if (ret != 1) {
+            int err = SSL_get_error(ssl, ret);
+            if (err == SSL_ERROR_WANT_READ) {
+                return Handshake::WANT_READ;
+            }
+            if (err == SSL_ERROR_WANT_WRITE) {
+                return Handshake::WANT_WRITE;
+            }
+            context.handshakeFailures.fetch_add(1, std::memory_order_relaxed);
+            ERR_clear_error();
+            return Handshake::FAILED;
+        }
+        established = true;
+        ktlsSend = BIO_get_ktls_send(SSL_get_wbio(ssl));
+        context.handshakes.fetch_add(1, std::memory_order_relaxed);
+        if (SSL_session_reused(ssl)) context.resumed.fetch_add(1, std::memory_order_relaxed);
+        if (ktlsSend) context.ktlsSend.fetch_add(1, std::memory_order_relaxed);
+        return Handshake::DONE;
+    }
+
+    ssize_t read(char* buf, size_t len) {
+        int n = SSL_read(ssl, buf, static_cast<int>(len));
+        return n > 0 ? n : fail(n);
+    }
+
+    ssize_t write(const char* buf, size_t len) {
+        int n = SSL_write(ssl, buf, static_cast<int>(len));
+        return n > 0 ? n : fail(n);
+    }
+
+    // 发送文件区间。kTLS 接管发送方向时由内核加密并直接从页缓存发送；
+    // 否则读入暂存区再 SSL_write，暂存区在 EAGAIN 后保留，满足 OpenSSL 重试时数据不变的要求。
+    ssize_t sendfile(int fileFd, off_t* offset, size_t count) {
+        if (ktlsSend) {
+            ossl_ssize_t n = SSL_sendfile(ssl, fileFd, *offset, count, 0);
+            if (n > 0) {
+                *offset += n;
+                return n;
+            }
+            return fail(static_cast<int>(n));
+        }
+        if (stage.empty() || stageOffset != *offset) {
+            stage.resize(std::min(count, STAGE_SIZE));
+            ssize_t r = pread(fileFd, &stage[0], stage.size(), *offset);
+            if (r <= 0) {
+                stage.clear();
+                if (r == 0) errno = EIO;
+                return -1;
+            }
+            stage.resize(r);
+            stageOffset = *offset;
+        }
+        ssize_t n = write(stage.data(), stage.size());
+        if (n > 0) {
+            stage.erase(0, n);
+            stageOffset += n;
+            *offset += n;
+        }
+        return n;
+    }
+
+    // 尽力发送 close_notify，不等待对端回应
+    void shutdown() {
+        if (ssl && established) {
+            SSL_shutdown(ssl);
+        }
+        ERR_clear_error();
+    }
+
+private:
+    static constexpr size_t STAGE_SIZE = 64 * 1024;
+
+    // 把 OpenSSL 的错误映射为套接字风格的返回值
+    ssize_t fail(int ret) {
+        int err = SSL_get_error(ssl, ret);
+        ERR_clear_error();
+        if (err == SSL_ERROR_WANT_READ || err == SSL_ERROR_WANT_WRITE) {
+            errno = EAGAIN;
+            return -1;
+        }
+        if (err == SSL_ERROR_ZERO_RETURN) {
+            return 0; // 对端发送了 close_notify
+        }
+        if (err != SSL_ERROR_SYSCALL) {
+            errno = EPROTO;
+        }
+        return -1;
+    }
+
+    TlsContext& context;
+    SSL* ssl;
+    bool established = false;
+    bool ktlsSend = false;
+    std::string stage;
+    off_t stageOffset = 0;
+};
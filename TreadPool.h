@@ -1,3 +1,4 @@
+#pragma once
 #include <vector>
 #include <queue>
 #include <thread>
@@ -5,10 +6,13 @@
 #include <condition_variable>
 #include <functional>
 #include <future>
+#include <pthread.h>
+#include <sched.h>
 
 class ThreadPool {
 public:
-    ThreadPool(size_t threads) : stop(false) {
+    // maxQueue 为 0 表示任务队列不设上限
+    ThreadPool(size_t threads, size_t maxQueue = 0) : maxQueue(maxQueue), stop(false) {
         for(size_t i = 0; i < threads; ++i) {
             workers.emplace_back([this] {
                 while(true) {
@@ -43,6 +47,42 @@ public:
         return res;
     }
 
+    // 有界提交：队列已满时立即返回 false，由调用方决定降级策略（例如返回 503）
+    bool tryEnqueue(std::function<void()> task) {
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            if(stop) return false;
+            if(maxQueue != 0 && tasks.size() >= maxQueue) return false;
+            tasks.emplace(std::move(task));
+        }
+        condition.notify_one();
+        return true;
+    }
+
+    size_t queueSize() {
+        std::unique_lock<std::mutex> lock(queue_mutex);
+        return tasks.size();
+    }
+
+    size_t threadCount() const {
+        return workers.size();
+    }
+
+    // 设置线程的 CPU 亲和性：spread 为 true 时第 i 个线程绑定到 cpus[i % n]，否则每个线程都可以在整个集合内调度
+    void setAffinity(const std::vector<int>& cpus, bool spread) {
+        if (cpus.empty()) return;
+        for (size_t i = 0; i < workers.size(); ++i) {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            if (spread) {
+                CPU_SET(cpus[i % cpus.size()], &set);
+            } else {
+                for (int cpu : cpus) CPU_SET(cpu, &set);
+            }
+            pthread_setaffinity_np(workers[i].native_handle(), sizeof(set), &set);
+        }
+    }
+
     ~ThreadPool() {
         {
             std::unique_lock<std::mutex> lock(queue_mutex);
@@ -59,5 +99,6 @@ private:
     std::queue<std::function<void()>> tasks;
     std::mutex queue_mutex;
     std::condition_variable condition;
+    size_t maxQueue;
     bool stop;
 };
@@ -0,0 +1,107 @@
+#pragma once
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// UrlEncodedParams 解析 application/x-www-form-urlencoded 格式（表单请求体和查询字符串）。
+// 键和值都是 string_view：不含转义的直接指向原始数据，不复制；
+// 只有含 '%' 或 '+' 的才解码到一块按输入大小一次性分配的 arena 中（解码结果不会比原文长）。
+// 分隔符和转义字符用 memchr 查找，glibc 的 memchr 是 SIMD 实现，长值只需扫描一遍。
+// 原始数据必须比本对象活得久。
+class UrlEncodedParams {
+public:
+    UrlEncodedParams() = default;
+    UrlEncodedParams(const UrlEncodedParams&) = delete;
+    UrlEncodedParams& operator=(const UrlEncodedParams&) = delete;
+    UrlEncodedParams(UrlEncodedParams&&) = default;
+    UrlEncodedParams& operator=(UrlEncodedParams&&) = default;
+
+    void parse(std::string_view input) {
+        clear();
+        arenaCapacity = input.size();
+        const char* p = input.data();
+        const char* end = p + input.size();
+        while (p < end) {
+            const char* amp = static_cast<const char*>(memchr(p, '&', end - p));
+            const char* pairEnd = amp ? amp : end;
+            if (pairEnd > p) {
+                const char* eq = static_cast<const char*>(memchr(p, '=', pairEnd - p));
+                std::string_view key(p, (eq ? eq : pairEnd) - p);
+                std::string_view value = eq ? std::string_view(eq + 1, pairEnd - eq - 1) : std::string_view();
+                params.emplace_back(decode(key), decode(value));
+            }
+            p = pairEnd + 1;
+        }
+    }
+
+    // 返回第一个同名参数的值，不存在时返回空
+    std::string_view get(std::string_view key) const {
+        for (const auto& param : params) {
+            if (param.first == key) {
+                return param.second;
+            }
+        }
+        return std::string_view();
+    }
+
+    bool has(std::string_view key) const {
+        for (const auto& param : params) {
+            if (param.first == key) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const std::vector<std::pair<std::string_view, std::string_view>>& items() const {
+        return params;
+    }
+
+    void clear() {
+        params.clear();
+        arena.reset();
+        arenaUsed = 0;
+        arenaCapacity = 0;
+    }
+
+private:
+    std::string_view decode(std::string_view s) {
+        if (s.empty() || (!memchr(s.data(), '%', s.size()) && !memchr(s.data(), '+', s.size()))) {
+            return s; // 常见情况：没有转义，零拷贝
+        }
+        if (!arena) {
+            arena.reset(new char[arenaCapacity]);
+        }
+        char* out = arena.get() + arenaUsed;
+        size_t n = 0;
+        for (size_t i = 0; i < s.size(); ++i) {
+            char c = s[i];
+            if (c == '+') {
+                out[n++] = ' ';
+            } else if (c == '%' && i + 2 < s.size() && isHex(s[i + 1]) && isHex(s[i + 2])) {
+                out[n++] = static_cast<char>((hexValue(s[i + 1]) << 4) | hexValue(s[i + 2]));
+                i += 2;
+            } else {
+                out[n++] = c; // 不完整的转义原样保留
+            }
+        }
+        arenaUsed += n;
+        return std::string_view(out, n);
+    }
+
+    static bool isHex(char c) {
+        return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+    }
+
+    static int hexValue(char c) {
+        if (c <= '9') return c - '0';
+        return (c | 0x20) - 'a' + 10;
+    }
+
+    std::vector<std::pair<std::string_view, std::string_view>> params;
+    std::unique_ptr<char[]> arena; // 移动本对象时地址不变，已返回的 string_view 仍然有效
+    size_t arenaUsed = 0;
+    size_t arenaCapacity = 0;
+};
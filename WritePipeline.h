@@ -0,0 +1,203 @@
+#pragma once
+#include "Logger.h"
+#include "Task.h"
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <coroutine>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+// WritePipeline 是上传文件的异步落盘流水线，由少量专用 I/O 线程执行。
+// 空闲的 I/O 线程平分队列中的待写任务，各自作为一批：先写临时文件，再逐个 fdatasync，
+// 然后原子 rename 到最终路径并同步所在目录，最后才通知调用方。
+// 各线程的 fdatasync 同时进行，文件系统会把它们合并到同一次日志提交中；
+// 某一批在同步时新到达的上传会自然聚成下一批，即组提交（group commit）。
+// 不用 syncfs：它会刷出整个文件系统的脏页（日志、抓包文件、其他程序的数据），
+// 而且 Linux 5.8 之前遇到回写错误仍返回 0，上传可能在没有持久化时被确认。
+class WritePipeline {
+public:
+    using Callback = std::function<void(bool ok)>;
+
+    explicit WritePipeline(size_t threads = 4) : threadCount(threads) {
+        for (size_t i = 0; i < threads; ++i) {
+            workers.emplace_back([this] { run(); });
+        }
+    }
+
+    ~WritePipeline() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        condition.notify_all();
+        for (auto& worker : workers) {
+            worker.join();
+        }
+    }
+
+    // 提交一次写入，数据持久化并 rename 到 path 之后在 I/O 线程上回调
+    void submit(const std::string& path, std::shared_ptr<const std::string> data, Callback done) {
+        Job job;
+        job.path = path;
+        job.data = std::move(data);
+        job.done = std::move(done);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pending.push_back(std::move(job));
+        }
+        condition.notify_one();
+    }
+
+    // 协程接口：co_await pipeline.write(path, data) 返回是否写入成功，在协程所属的事件循环上恢复
+    class WriteAwaiter {
+    public:
+        WriteAwaiter(WritePipeline& pipeline, std::string path, std::shared_ptr<const std::string> data)
+            : pipeline(pipeline), path(std::move(path)), data(std::move(data)) {}
+
+        bool await_ready() const noexcept { return false; }
+
+        void await_suspend(std::coroutine_handle<> h) {
+            ResumeExecutor* owner = ResumeExecutor::current();
+            pipeline.submit(path, data, [this, h, owner](bool ok) {
+                result = ok;
+                if (owner) {
+                    owner->post([h]() { h.resume(); });
+                } else {
+                    h.resume();
+                }
+            });
+        }
+
+        bool await_resume() const noexcept { return result; }
+
+    private:
+        WritePipeline& pipeline;
+        std::string path;
+        std::shared_ptr<const std::string> data;
+        bool result = false;
+    };
+
+    WriteAwaiter write(const std::string& path, std::shared_ptr<const std::string> data) {
+        return WriteAwaiter(*this, path, std::move(data));
+    }
+
+private:
+    struct Job {
+        std::string path;
+        std::shared_ptr<const std::string> data;
+        Callback done;
+        std::string tmp;
+        int fd = -1;
+        bool ok = false;
+    };
+
+    void run() {
+        while (true) {
+            std::vector<Job> batch;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [this] { return stop || !pending.empty(); });
+                if (stop && pending.empty()) return;
+                // 取走当前空闲线程应得的一份，剩下的留给其他线程并行同步
+                size_t idle = threadCount - busy;
+                size_t take = (pending.size() + idle - 1) / idle;
+                batch.assign(std::make_move_iterator(pending.begin()), std::make_move_iterator(pending.begin() + take));
+                pending.erase(pending.begin(), pending.begin() + take);
+                ++busy;
+                if (!pending.empty()) {
+                    condition.notify_one();
+                }
+            }
+            processBatch(batch);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                --busy;
+            }
+        }
+    }
+
+    void processBatch(std::vector<Job>& batch) {
+        // 1. 写临时文件
+        for (auto& job : batch) {
+            job.tmp = job.path + ".tmp." + std::to_string(tmpSequence++);
+            job.fd = open(job.tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+            if (job.fd < 0) {
+                LOG_ERROR("Failed to open file for writing: %s, error: %s", job.tmp.c_str(), strerror(errno));
+                continue;
+            }
+            job.ok = writeAll(job.fd, *job.data);
+            if (!job.ok) {
+                LOG_ERROR("Failed to write file: %s, error: %s", job.tmp.c_str(), strerror(errno));
+            }
+        }
+
+        // 2. 逐个 fdatasync，只刷这一批自己的数据，回写错误能可靠地报告给对应的上传
+        for (auto& job : batch) {
+            if (job.ok && fdatasync(job.fd) != 0) {
+                LOG_ERROR("fdatasync failed for %s: %s", job.tmp.c_str(), strerror(errno));
+                job.ok = false;
+            }
+        }
+
+        // 3. 原子 rename 到最终路径，并同步涉及到的目录使 rename 持久化
+        std::set<std::string> dirs;
+        for (auto& job : batch) {
+            if (job.fd >= 0) close(job.fd);
+            if (job.ok && rename(job.tmp.c_str(), job.path.c_str()) != 0) {
+                LOG_ERROR("Failed to rename %s to %s", job.tmp.c_str(), job.path.c_str());
+                job.ok = false;
+            }
+            if (!job.ok) {
+                unlink(job.tmp.c_str());
+                continue;
+            }
+            size_t slash = job.path.rfind('/');
+            dirs.insert(slash == std::string::npos ? "." : job.path.substr(0, slash));
+        }
+        for (const auto& dir : dirs) {
+            int dirFd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+            if (dirFd >= 0) {
+                fsync(dirFd);
+                close(dirFd);
+            }
+        }
+
+        // 4. 数据已经持久化，通知调用方
+        for (auto& job : batch) {
+            job.done(job.ok);
+        }
+    }
+
+    static bool writeAll(int fd, const std::string& data) {
+        size_t written = 0;
+        while (written < data.size()) {
+            ssize_t n = ::write(fd, data.data() + written, data.size() - written);
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                return false;
+            }
+            written += n;
+        }
+        return true;
+    }
+
+    size_t threadCount;
+    std::vector<std::thread> workers;
+    std::vector<Job> pending;
+    std::mutex mutex;
+    std::condition_variable condition;
+    size_t busy = 0; // 正在处理批次的线程数，受 mutex 保护
+    std::atomic<uint64_t> tmpSequence{0};
+    bool stop = false;
+};
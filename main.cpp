@@ -1,20 +1,58 @@
-
 #include "HttpServer.h"
 #include "Database.h"
+#include "Config.h"
 
 int main(int argc, char* argv[]) {
-    int port = 8080; // 默认端口
-    if (argc > 1) {
-        port = std::stoi(argv[1]); // 从命令行获取端口
+    // 参数来自配置文件、环境变量和命令行，见 Config.h；兼容旧用法 ./myserver <端口>
+    ServerConfig config;
+    if (!config.load(argc, argv)) {
+        return 1;
+    }
+    CpuTopology topology = CpuTopology::detect();
+    config.autoSize(topology);
+    LOG_INFO("Configuration: %s", config.toString().c_str());
+
+    Database db(config.mongoUri, config.dbThreads); // mongo_uri 要根据你mongo的实际IP修改
+    HttpServer server(config.port, config.maxEvents, db, config.executorConfig());
+    for (const auto& endpoint : config.listen) {
+        server.addListener(endpoint);
+    }
+    server.setBacklog(config.backlog);
+    server.setReadBufferSize(config.readBufferSize);
+    if (config.pinThreads) {
+        server.setThreadPlacement(ThreadPlacement::plan(topology));
+    }
+    if (config.busyPoll) {
+        server.enableBusyPoll(config.busyPollUsecs, std::chrono::milliseconds(config.busyPollIdleMs));
+    }
+    if (config.rateLimit > 0 || config.maxClientConnections > 0) {
+        ClientLimiter::Limits limits;
+        limits.requestsPerSecond = config.rateLimit;
+        limits.burst = config.rateBurst;
+        limits.maxConnections = config.maxClientConnections;
+        server.setClientLimits(limits);
+    }
+    if (!server.setTrustedProxies(config.trustedProxies)) {
+        return 1;
+    }
+    Compression::Policy compression;
+    compression.enabled = config.compression;
+    compression.level = config.compressionLevel;
+    compression.minSize = config.compressionMinSize;
+    server.setCompression(compression);
+    if (!config.captureFile.empty() &&
+        !server.enableCapture(config.captureFile, config.captureSample, config.captureMaxSize)) {
+        return 1;
+    }
+    // 配置了证书时由服务器直接终止 TLS，不再需要前面的 nginx
+    if (!config.tlsCert.empty() && !server.enableTls(config.tlsCert, config.tlsKey)) {
+        return 1;
     }
-    Database db("mongodb://172.20.0.2:27017"); // 初始化数据库，这里要根据你mongo的实际IP修改
-    HttpServer server(port, 10, db);
     server.setupRoutes();
     server.start();
     return 0;
 }
 
-
 // #include "HttpServer.h"
 // #include "Database.h"
 
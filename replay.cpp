@@ -0,0 +1,204 @@
+// 回放 Capture.h 记录的请求，报告延迟分位数：
+//     g++ -std=c++20 -O2 -pthread replay.cpp -o replay
+//     ./replay capture.bin --target=127.0.0.1:8080 --speed=1 --concurrency=64
+// --target       host:port 或 unix:/path
+// --speed        1 按原始节奏，2 两倍速，max 不等待、尽快发送
+// --concurrency  同时进行的连接数；每个请求使用一个新连接，与服务器处理完响应即关闭连接的行为一致
+// --max-gap-ms   两个请求之间的间隔最多等待多久，跳过抓包文件中多次运行之间的空档
+// 按节奏回放时延迟从计划发送的时刻算起，服务器变慢导致的排队也计入延迟，不会被回放端的等待掩盖。
+#include "Capture.h"
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+struct Options {
+    std::string captureFile;
+    std::string target = "127.0.0.1:8080";
+    double speed = 1; // 0 表示最快速度
+    int concurrency = 64;
+    long maxGapMs = 1000;
+};
+
+struct Result {
+    double latencyMs;
+    int status; // 0 表示连接或读写失败
+};
+
+static bool parseOptions(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg.compare(0, 2, "--") != 0) {
+            options.captureFile = arg;
+            continue;
+        }
+        size_t eq = arg.find('=');
+        if (eq == std::string::npos) return false;
+        std::string key = arg.substr(2, eq - 2);
+        std::string value = arg.substr(eq + 1);
+        if (key == "target") options.target = value;
+        else if (key == "speed") options.speed = value == "max" ? 0 : std::atof(value.c_str());
+        else if (key == "concurrency") options.concurrency = std::max(1, std::atoi(value.c_str()));
+        else if (key == "max-gap-ms") options.maxGapMs = std::atol(value.c_str());
+        else return false;
+    }
+    return !options.captureFile.empty() && options.speed >= 0;
+}
+
+static int connectTarget(const std::string& target) {
+    if (target.compare(0, 5, "unix:") == 0) {
+        struct sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        std::string path = target.substr(5);
+        if (path.size() >= sizeof(address.sun_path)) return -1;
+        memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd >= 0 && connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0) {
+            close(fd);
+            return -1;
+        }
+        return fd;
+    }
+
+    size_t colon = target.rfind(':');
+    if (colon == std::string::npos) return -1;
+    std::string host = target.substr(0, colon);
+    std::string port = target.substr(colon + 1);
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo* result = nullptr;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0) return -1;
+    int fd = -1;
+    for (struct addrinfo* ai = result; ai; ai = ai->ai_next) {
+        fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+        if (fd >= 0 && connect(fd, ai->ai_addr, ai->ai_addrlen) == 0) break;
+        if (fd >= 0) close(fd);
+        fd = -1;
+    }
+    freeaddrinfo(result);
+    if (fd >= 0) {
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+    return fd;
+}
+
+// 发送一个请求并读到服务器关闭连接，返回状态码，失败返回 0
+static int sendRequest(const std::string& target, const std::string& request) {
+    int fd = connectTarget(target);
+    if (fd < 0) return 0;
+    struct timeval timeout = {30, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    size_t sent = 0;
+    while (sent < request.size()) {
+        ssize_t n = send(fd, request.data() + sent, request.size() - sent, MSG_NOSIGNAL);
+        if (n <= 0) {
+            close(fd);
+            return 0;
+        }
+        sent += n;
+    }
+
+    std::string head;
+    char buf[16384];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+        if (head.size() < 16) head.append(buf, std::min<size_t>(n, 16 - head.size()));
+    }
+    close(fd);
+    // "HTTP/1.1 200 OK"
+    if (n < 0 || head.size() < 12 || head.compare(0, 5, "HTTP/") != 0) return 0;
+    return std::atoi(head.c_str() + 9);
+}
+
+static double percentile(const std::vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t index = static_cast<size_t>(p / 100 * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(index, sorted.size() - 1)];
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        fprintf(stderr, "usage: %s <capture> [--target=host:port|unix:/path] [--speed=1|N|max] "
+                        "[--concurrency=64] [--max-gap-ms=1000]\n", argv[0]);
+        return 1;
+    }
+    std::vector<TrafficCapture::Record> records;
+    if (!TrafficCapture::load(options.captureFile, records) || records.empty()) {
+        fprintf(stderr, "cannot read requests from %s\n", options.captureFile.c_str());
+        return 1;
+    }
+
+    // 计划发送时刻（相对回放开始），时间戳回拨时按零间隔处理
+    std::vector<Clock::duration> schedule(records.size());
+    for (size_t i = 1; i < records.size(); ++i) {
+        uint64_t prev = records[i - 1].timestampUs, cur = records[i].timestampUs;
+        long gapUs = cur > prev ? static_cast<long>(std::min<uint64_t>(cur - prev, options.maxGapMs * 1000)) : 0;
+        auto scaled = options.speed > 0 ? std::chrono::microseconds(static_cast<long>(gapUs / options.speed))
+                                        : std::chrono::microseconds(0);
+        schedule[i] = schedule[i - 1] + scaled;
+    }
+
+    std::atomic<size_t> next{0};
+    std::mutex resultsMutex;
+    std::vector<Result> results;
+    results.reserve(records.size());
+    Clock::time_point start = Clock::now();
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < options.concurrency; ++t) {
+        workers.emplace_back([&]() {
+            std::vector<Result> local;
+            size_t i;
+            while ((i = next.fetch_add(1)) < records.size()) {
+                Clock::time_point planned = start + schedule[i];
+                if (options.speed > 0) std::this_thread::sleep_until(planned);
+                Clock::time_point begin = options.speed > 0 ? planned : Clock::now();
+                int status = sendRequest(options.target, records[i].data);
+                double ms = std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+                local.push_back({ms, status});
+            }
+            std::lock_guard<std::mutex> lock(resultsMutex);
+            results.insert(results.end(), local.begin(), local.end());
+        });
+    }
+    for (auto& worker : workers) worker.join();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::vector<double> latencies;
+    std::map<int, size_t> statuses;
+    for (const auto& result : results) {
+        latencies.push_back(result.latencyMs);
+        ++statuses[result.status];
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    char speed[32] = "max";
+    if (options.speed > 0) snprintf(speed, sizeof(speed), "%gx", options.speed);
+    printf("requests %zu in %.2fs, %.1f req/s, concurrency %d, speed %s\n", results.size(), seconds,
+           results.size() / seconds, options.concurrency, speed);
+    printf("latency ms: p50 %.3f  p90 %.3f  p99 %.3f  p99.9 %.3f  max %.3f\n", percentile(latencies, 50),
+           percentile(latencies, 90), percentile(latencies, 99), percentile(latencies, 99.9),
+           latencies.empty() ? 0 : latencies.back());
+    for (const auto& entry : statuses) {
+        if (entry.first == 0) printf("  errors: %zu\n", entry.second);
+        else printf("  %d: %zu\n", entry.first, entry.second);
+    }
+    return 0;
+}